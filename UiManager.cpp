@@ -1,4 +1,5 @@
 #include "UiManager.h"
+#include "trace.h"
 
 #pragma region Global Variables
 
@@ -510,7 +511,8 @@ void UiManager::Render_BoxUIs() {
     for (auto& box : boxes) {
 
         if (box.getColor) {
-            SetRenderDrawColor(renderer, box.getColor());
+            box.BoxColor = box.getColor(); //Last drawn color, for NeedsRedraw
+            SetRenderDrawColor(renderer, box.BoxColor);
             SDL_RenderFillRect(renderer, &box.Box_rect);
         }
 
@@ -607,8 +609,13 @@ void UiManager::Render_ButtonUIs() {
 void UiManager::Render_TextUIs() {
     for (auto& txt : texts) {
         if (txt.Dynamic) {
-            txt.label = (txt.getLabel) ? txt.getLabel() : txt.label;
-            CreateTextTexture(txt);
+            std::string label = (txt.getLabel) ? txt.getLabel() : txt.label;
+
+            //Only re render the text when it actually changed
+            if (txt.dirty || label != txt.label) {
+                txt.label = label;
+                CreateTextTexture(txt);
+            }
         }
 
         else if (txt.dirty) {
@@ -670,6 +677,8 @@ void UiManager::HandleUiEvents(SDL_Event& event) {
 
     SDL_Point mousePoint = { mouseX, mouseY };
 
+    redraw = true;
+
     Handle_DropdownUI(event, mousePoint);
     Handle_ButtonUI(event, mousePoint);
     Handle_ColorPickerUI(event, mousePoint);
@@ -677,6 +686,8 @@ void UiManager::HandleUiEvents(SDL_Event& event) {
 }
 
 void UiManager::Render() {
+    SAND_TRACE_SCOPE("UiManager::Render");
+
     SetRenderDrawColor(renderer, DefaultColor);
 
     Render_BoxUIs();
@@ -687,6 +698,30 @@ void UiManager::Render() {
     Render_DropdownUIs();
 
     SetRenderDrawColor(renderer, DefaultColor);
+
+    redraw = false;
+}
+
+bool UiManager::NeedsRedraw() {
+    if (redraw) return true;
+
+    for (auto& txt : texts) {
+        if (txt.Dynamic && txt.getLabel && txt.getLabel() != txt.label) return true;
+    }
+
+    for (auto& btn : buttons) {
+        if (btn.textObj.Dynamic && btn.textObj.getLabel && btn.textObj.getLabel() != btn.textObj.label) return true;
+    }
+
+    for (auto& box : boxes) {
+        if (!box.getColor) continue;
+
+        SDL_Color color = box.getColor();
+
+        if (color.r != box.BoxColor.r || color.g != box.BoxColor.g || color.b != box.BoxColor.b || color.a != box.BoxColor.a) return true;
+    }
+
+    return false;
 }
 
 #pragma endregion
\ No newline at end of file
@@ -36,6 +36,7 @@ class UiManager {
 		void HandleUiEvents(SDL_Event& event);
 		void Update();
 		void Render();
+		bool NeedsRedraw(); //True if an event came in or a dynamic text/color changed since the last Render
 
 		void SetRenderDrawColor(SDL_Renderer* renderer, SDL_Color color);
 
@@ -143,6 +144,8 @@ class UiManager {
 		
 		SDL_Color DefaultColor;
 
+		bool redraw = true;
+
 		void InitializeColorPicker(ColorPicker& picker);
 		void UpdateColorPickerTexture(SDL_Renderer* renderer, ColorPicker& cPicker);
 		void RenderText(const std::string& text, int x, int y, SDL_Color color);
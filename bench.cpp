@@ -0,0 +1,177 @@
+// C++ Standard Libraries
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstdint>
+#include <chrono>
+#include <algorithm>
+
+#include "constants.h"
+#include "grid.h"
+#include "simulation.h"
+#include "scenes.h"
+
+#ifdef SANDMAKER_BENCH_RENDER
+// Third Party
+#include <SDL.h>
+
+#include "view.h"
+#endif
+
+//Benchmarks UpdateGrid (and RenderGrid when built with SDL) on every scene across a few grid
+//sizes. Each repetition rebuilds the scene from the same seed so the runs are comparable.
+//Reports the median and fastest repetition in ns per cell per tick.
+
+#pragma region Global Variables
+
+const uint64_t BENCH_SEED = 1234;
+
+std::vector<int> Sizes = { 128, 256, 512 }; //Square grids
+int Ticks = 100; //Ticks per repetition
+int Repetitions = 5;
+int RenderFrames = 20;
+int UpdateThreads = 1;
+std::string Filter; //Only run scenes whose name contains this
+
+#pragma endregion
+
+#pragma region Helper Functions
+
+using Clock = std::chrono::steady_clock;
+
+void PrintUsage() {
+    std::cout << "Usage: sandbench [--quick] [--ticks N] [--reps N] [--threads N] [--filter TEXT]\n";
+}
+
+bool ParseArgs(int argc, char* argv[]) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+
+        if (arg == "--quick") {
+            Sizes = { 128 };
+            Ticks = 20;
+            Repetitions = 3;
+            RenderFrames = 5;
+            continue;
+        }
+
+        if (arg == "--help" || arg == "-h" || i + 1 >= argc) return false;
+
+        std::string value = argv[++i];
+
+        if (arg == "--ticks") Ticks = std::max(1, std::atoi(value.c_str()));
+        else if (arg == "--reps") Repetitions = std::max(1, std::atoi(value.c_str()));
+        else if (arg == "--threads") UpdateThreads = std::max(1, std::atoi(value.c_str()));
+        else if (arg == "--filter") Filter = value;
+        else return false;
+    }
+
+    return true;
+}
+
+double Median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+void PrintResult(const std::string& name, int size, const std::vector<double>& nsPerCell) {
+    std::cout << std::left << std::setw(28) << name
+        << std::right << std::setw(5) << size << "x" << std::left << std::setw(6) << size
+        << std::right << std::fixed << std::setprecision(3)
+        << std::setw(12) << Median(nsPerCell)
+        << std::setw(12) << *std::min_element(nsPerCell.begin(), nsPerCell.end()) << "\n";
+}
+
+#pragma endregion
+
+#pragma region Benchmarks
+
+//Time Ticks updates from a fresh scene, in ns per cell per tick
+double TimeUpdate(CellGrid& Grid, const std::string& scene) {
+    SeedSimulation(Grid, BENCH_SEED);
+    BuildScene(Grid, scene);
+
+    BrushInput NoBrush;
+
+    Clock::time_point start = Clock::now();
+
+    for (int tick = 0; tick < Ticks; tick++) {
+        UpdateGrid(Grid, NoBrush);
+    }
+
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    return ns / (static_cast<double>(Grid.Length()) * Grid.Width() * Ticks);
+}
+
+#ifdef SANDMAKER_BENCH_RENDER
+//Time drawing the grid as it is into an offscreen software renderer, in ns per cell per frame
+double TimeRender(CellGrid& Grid, SDL_Renderer* renderer) {
+    Clock::time_point start = Clock::now();
+
+    for (int frame = 0; frame < RenderFrames; frame++) {
+        InvalidateGridTexture(); //Time a full redraw, an idle grid would upload nothing
+        RenderGrid(renderer, Grid);
+    }
+
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    return ns / (static_cast<double>(Grid.Length()) * Grid.Width() * RenderFrames);
+}
+#endif
+
+#pragma endregion
+
+int main(int argc, char* argv[]) {
+    if (!ParseArgs(argc, argv)) {
+        PrintUsage();
+        return 1;
+    }
+
+    SetUpdateThreads(UpdateThreads);
+
+#ifdef SANDMAKER_BENCH_RENDER
+    InitializeColors();
+#endif
+
+    std::cout << "Ticks: " << Ticks << ", Repetitions: " << Repetitions << ", Threads: " << UpdateThreads << "\n\n";
+    std::cout << std::left << std::setw(28) << "Benchmark" << std::setw(12) << "Grid"
+        << std::right << std::setw(12) << "ns/cell" << std::setw(12) << "min" << "\n";
+
+    for (const std::string& scene : GetSceneNames()) {
+        if (scene.find(Filter) == std::string::npos) continue;
+
+        for (int size : Sizes) {
+            CellGrid Grid(size, size);
+            std::vector<double> results;
+
+            for (int rep = 0; rep < Repetitions; rep++) {
+                results.push_back(TimeUpdate(Grid, scene));
+            }
+
+            PrintResult("UpdateGrid/" + scene, size, results);
+
+#ifdef SANDMAKER_BENCH_RENDER
+            SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, size * CELL_SIZE, size * CELL_SIZE, 32, SDL_PIXELFORMAT_ARGB8888);
+            SDL_Renderer* renderer = surface ? SDL_CreateSoftwareRenderer(surface) : nullptr;
+
+            if (renderer) {
+                results.clear();
+
+                for (int rep = 0; rep < Repetitions; rep++) {
+                    results.push_back(TimeRender(Grid, renderer));
+                }
+
+                PrintResult("RenderGrid/" + scene, size, results);
+
+                ReleaseGridTexture();
+                SDL_DestroyRenderer(renderer);
+            }
+
+            if (surface) SDL_FreeSurface(surface);
+#endif
+        }
+    }
+
+    return 0;
+}
@@ -1,17 +1,19 @@
 #pragma once
 //Constants
 
+//Default grid size, can be overridden at startup (SandMaker <length> <width>)
 const int GRID_LENGTH = 150;
 const int GRID_WIDTH = 150;
 const int CELL_SIZE = 5;
 const int SELECTION_SIZE = 1;
 
+const int CACHE_LINE_SIZE = 64;
+const int CHUNK_SIZE = 32; //Chunk edge length in cells, chunks sleep when nothing in them changes
+
 const int HORIZONTAL_PADDING = CELL_SIZE * 70;
 const int VERTICAL_PADDING = 0;
 
-const int WINDOW_WIDTH = HORIZONTAL_PADDING + (CELL_SIZE * GRID_WIDTH);
-const int WINDOW_HEIGHT = VERTICAL_PADDING + (CELL_SIZE * GRID_LENGTH);
-
 const int FPS_CAP = 60;
 const int FRAME_DELAY = 1000 / FPS_CAP;
-const float FIXED_TIMESTEP = 1.0f / FPS_CAP;
\ No newline at end of file
+const float FIXED_TIMESTEP = 1.0f / FPS_CAP;
+const int MAX_CATCHUP_TICKS = 5; //Ticks the sim thread can fall behind before it stops trying to catch up
\ No newline at end of file
@@ -0,0 +1,199 @@
+#include "grid.h"
+
+// C++ Standard Libraries
+#include <cstdlib>
+#include <new>
+#include <cstring>
+#include <algorithm>
+
+#pragma region Helper Functions
+
+void* AlignedAlloc(size_t size, size_t alignment) {
+#ifdef _MSC_VER
+    return _aligned_malloc(size, alignment);
+#else
+    void* ptr = nullptr;
+    if (posix_memalign(&ptr, alignment, size) != 0) return nullptr;
+    return ptr;
+#endif
+}
+
+void AlignedFree(void* ptr) {
+#ifdef _MSC_VER
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
+
+//Smallest stride (in cells) >= width where every plane row starts on a cache line
+int AlignedStride(int width) {
+    return (width + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+}
+
+#pragma endregion
+
+#pragma region Chunk Methods
+
+void CellGrid::WakeRect(int minY, int minX, int maxY, int maxX) {
+    //The outer ring is never updated, but in a sparse world's window (no bedrock border) particles
+    //can still move onto it. No chunk rect covers those cells, so they're only kept for redrawing.
+    if (minX < 1 || minY < 1 || maxX > width - 2 || maxY > length - 2) {
+        edgeDirty.Include(std::max(minX, 0), std::max(minY, 0), std::min(maxX, width - 1), std::min(maxY, length - 1));
+    }
+
+    //Only interior cells get updated, the border is bedrock
+    minX = std::max(minX, 1);
+    minY = std::max(minY, 1);
+    maxX = std::min(maxX, width - 2);
+    maxY = std::min(maxY, length - 2);
+
+    if (maxX < minX || maxY < minY) return;
+
+    //The rect can spill over into neighbouring chunks
+    for (int cy = minY / CHUNK_SIZE; cy <= maxY / CHUNK_SIZE; cy++) {
+        for (int cx = minX / CHUNK_SIZE; cx <= maxX / CHUNK_SIZE; cx++) {
+            int chunkMinX = cx * CHUNK_SIZE;
+            int chunkMinY = cy * CHUNK_SIZE;
+
+            Chunk& chunk = GetChunk(cy, cx);
+
+            int x0 = std::max(minX, chunkMinX);
+            int y0 = std::max(minY, chunkMinY);
+            int x1 = std::min(maxX, chunkMinX + CHUNK_SIZE - 1);
+            int y1 = std::min(maxY, chunkMinY + CHUNK_SIZE - 1);
+
+            chunk.nextRect.Include(x0, y0, x1, y1);
+
+            //Queue the particles in the rect that aren't queued yet. Chunks updating at the same
+            //time never reach the same cell, so only the list itself needs the lock.
+            bool locked = false;
+
+            for (int y = y0; y <= y1; y++) {
+                for (int x = x0; x <= x1; x++) {
+                    size_t i = Index(y, x);
+                    CellWord word = words[i];
+
+                    if ((word & WORD_QUEUED) || !CanUpdate(WordState(word))) continue;
+
+                    if (!locked) {
+                        chunk.nextActiveLock.lock();
+                        locked = true;
+                    }
+
+                    words[i] = word | WORD_QUEUED;
+                    chunk.nextActive.push_back(static_cast<uint32_t>(i));
+                }
+            }
+
+            if (locked) chunk.nextActiveLock.unlock();
+        }
+    }
+}
+
+void CellGrid::WakeAll() {
+    WakeRect(0, 0, length - 1, width - 1);
+}
+
+void CellGrid::ClearWake() {
+    for (int i = 0; i < chunksX * chunksY; i++) {
+        Chunk& chunk = chunks[i];
+
+        chunk.rect = DirtyRect();
+        chunk.nextRect.Take();
+        chunk.active.clear();
+        chunk.nextActive.clear();
+    }
+
+    size_t count = static_cast<size_t>(length) * stride;
+    for (size_t i = 0; i < count; i++) {
+        words[i] &= ~WORD_QUEUED;
+    }
+
+    edgeDirty.Take();
+
+    renderDirty = DirtyRect();
+    renderDirty.Include(0, 0, width - 1, length - 1);
+}
+
+void CellGrid::BeginTick() {
+    for (int i = 0; i < chunksX * chunksY; i++) {
+        Chunk& chunk = chunks[i];
+
+        chunk.rect = chunk.nextRect.Take();
+
+        if (!chunk.rect.Empty()) {
+            renderDirty.Include(chunk.rect.minX, chunk.rect.minY, chunk.rect.maxX, chunk.rect.maxY);
+        }
+
+        std::swap(chunk.active, chunk.nextActive);
+        chunk.nextActive.clear();
+
+        //Off the next tick list, so they can be queued again while they update
+        for (uint32_t cell : chunk.active) {
+            words[cell] &= ~WORD_QUEUED;
+        }
+    }
+}
+
+void CellGrid::RestoreWake(int chunk, const DirtyRect& rect) {
+    if (!rect.Empty()) chunks[chunk].nextRect.Include(rect.minX, rect.minY, rect.maxX, rect.maxY);
+}
+
+void CellGrid::RestoreQueued(int y, int x) {
+    size_t i = Index(y, x);
+    if (words[i] & WORD_QUEUED) return;
+
+    words[i] |= WORD_QUEUED;
+    GetChunk(y / CHUNK_SIZE, x / CHUNK_SIZE).nextActive.push_back(static_cast<uint32_t>(i));
+}
+
+DirtyRect CellGrid::TakeRenderDirty() {
+    DirtyRect rect = renderDirty;
+    renderDirty = DirtyRect();
+
+    //Changes from the last tick (or the brush) that haven't been moved into place yet
+    for (int i = 0; i < chunksX * chunksY; i++) {
+        DirtyRect pending = chunks[i].nextRect.Peek();
+
+        if (!pending.Empty()) {
+            rect.Include(pending.minX, pending.minY, pending.maxX, pending.maxY);
+        }
+    }
+
+    DirtyRect edge = edgeDirty.Take();
+
+    if (!edge.Empty()) {
+        rect.Include(edge.minX, edge.minY, edge.maxX, edge.maxY);
+    }
+
+    return rect;
+}
+
+#pragma endregion
+
+#pragma region Grid Methods
+
+CellGrid::CellGrid(int length_, int width_) : length(length_), width(width_), stride(AlignedStride(width_)) {
+    size_t count = static_cast<size_t>(length) * stride;
+
+    memory = static_cast<uint8_t*>(AlignedAlloc(count * (sizeof(CellWord) + 1), CACHE_LINE_SIZE));
+    if (!memory) throw std::bad_alloc();
+
+    std::memset(memory, 0, count * (sizeof(CellWord) + 1)); //EMPTY, dry, no flags, no timer
+
+    words = reinterpret_cast<CellWord*>(memory);
+    comboTimers = memory + count * sizeof(CellWord);
+
+    materialCounts[static_cast<int>(CellState::EMPTY)] = static_cast<int64_t>(length) * width;
+
+    chunksX = (width + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    chunksY = (length + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    chunks.reset(new Chunk[static_cast<size_t>(chunksX) * chunksY]);
+}
+
+CellGrid::~CellGrid() {
+    AlignedFree(memory);
+}
+
+#pragma endregion
@@ -0,0 +1,315 @@
+#pragma once
+// C++ Standard Libraries
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <memory>
+#include <climits>
+#include <vector>
+
+#include "constants.h"
+#include "threadpool.h"
+#include "rng.h"
+
+enum class CellState : uint8_t {
+    EMPTY = 0,
+    SAND,
+    ROCK,
+    BEDROCK,
+    WATER,
+    ACID
+};
+
+constexpr int NUM_MATERIALS = 6; //Number of CellStates
+
+struct Cell {
+    CellState state; //Cell state, sand, water, etc.
+    uint8_t wetness = 0; //Wetness value, 0 = dry, 100 = fully wet.
+    uint8_t comboTimer = 0; //Combo timers per cell for delays.
+    uint8_t velocity = 0; //Cells per tick the particle is falling at, 0 for resting particles and empty cells
+};
+
+const uint8_t MAX_WETNESS = 100; //Fully wet
+const uint8_t MAX_VELOCITY = 15; //Fastest fall, also bounds how far one update can reach (see PaintGrid)
+
+//Packed cell word, the state and wetness of a cell in one load:
+//  bits 0-6   wetness (0 - MAX_WETNESS)
+//  bit 7      queued flag
+//  bits 8-11  state
+//  bits 12-15 velocity (0 - MAX_VELOCITY)
+//Each field sits inside one byte so reads and writes stay byte sized. State and wetness together
+//(WORD_CELL_MASK) index the render palette directly. The combo timer counts up to 255 so it
+//doesn't fit, and stays in its own byte plane.
+using CellWord = uint16_t;
+
+const int WORD_STATE_SHIFT = 8;
+const int WORD_VELOCITY_SHIFT = 12;
+
+constexpr CellWord WORD_WETNESS_MASK = 0x007F;
+constexpr CellWord WORD_QUEUED = 0x0080; //On its chunk's nextActive list
+constexpr CellWord WORD_STATE_MASK = 0x0F00;
+constexpr CellWord WORD_VELOCITY_MASK = 0xF000;
+constexpr CellWord WORD_CELL_MASK = WORD_STATE_MASK | WORD_WETNESS_MASK; //State and wetness, the palette index
+constexpr CellWord WORD_PARTICLE_MASK = WORD_CELL_MASK | WORD_VELOCITY_MASK; //Everything that moves with a particle
+
+static_assert(NUM_MATERIALS <= (WORD_STATE_MASK >> WORD_STATE_SHIFT) + 1, "CellState doesn't fit the state bits");
+static_assert(MAX_WETNESS <= WORD_WETNESS_MASK, "Wetness doesn't fit the wetness bits");
+static_assert(MAX_VELOCITY <= (WORD_VELOCITY_MASK >> WORD_VELOCITY_SHIFT), "Velocity doesn't fit the velocity bits");
+
+constexpr CellState WordState(CellWord word) { return static_cast<CellState>((word & WORD_STATE_MASK) >> WORD_STATE_SHIFT); }
+constexpr uint8_t WordWetness(CellWord word) { return static_cast<uint8_t>(word & WORD_WETNESS_MASK); }
+constexpr uint8_t WordVelocity(CellWord word) { return static_cast<uint8_t>(word >> WORD_VELOCITY_SHIFT); }
+
+constexpr CellWord MakeWord(CellState state, uint8_t wetness, uint8_t velocity = 0) {
+    return static_cast<CellWord>((velocity << WORD_VELOCITY_SHIFT) | (static_cast<int>(state) << WORD_STATE_SHIFT) | (wetness & WORD_WETNESS_MASK));
+}
+
+//Cells that go on the update worklist. Everything else only changes when a neighbor changes it.
+inline bool CanUpdate(CellState state) {
+    return state != CellState::EMPTY && state != CellState::BEDROCK;
+}
+
+inline bool operator==(const Cell& a, const Cell& b) {
+    return a.state == b.state && a.wetness == b.wetness && a.comboTimer == b.comboTimer && a.velocity == b.velocity;
+}
+
+inline bool operator!=(const Cell& a, const Cell& b) {
+    return !(a == b);
+}
+
+//Inclusive cell rectangle, empty when max < min.
+struct DirtyRect {
+    int minX = 0, minY = 0;
+    int maxX = -1, maxY = -1;
+
+    bool Empty() const { return maxX < minX || maxY < minY; }
+
+    void Include(int x0, int y0, int x1, int y1) {
+        if (Empty()) {
+            minX = x0; minY = y0;
+            maxX = x1; maxY = y1;
+            return;
+        }
+
+        if (x0 < minX) minX = x0;
+        if (y0 < minY) minY = y0;
+        if (x1 > maxX) maxX = x1;
+        if (y1 > maxY) maxY = y1;
+    }
+};
+
+//DirtyRect that several update threads can widen at the same time.
+//Widening only writes when the rect actually grows, so the usual case is four plain loads.
+struct SharedRect {
+    std::atomic<int> minX{ INT_MAX }, minY{ INT_MAX };
+    std::atomic<int> maxX{ INT_MIN }, maxY{ INT_MIN };
+
+    void Include(int x0, int y0, int x1, int y1) {
+        AtomicMin(minX, x0);
+        AtomicMin(minY, y0);
+        AtomicMax(maxX, x1);
+        AtomicMax(maxY, y1);
+    }
+
+    //Read the rect without resetting it
+    DirtyRect Peek() const {
+        DirtyRect rect;
+
+        if (minX.load(std::memory_order_relaxed) != INT_MAX) {
+            rect.minX = minX.load(std::memory_order_relaxed);
+            rect.minY = minY.load(std::memory_order_relaxed);
+            rect.maxX = maxX.load(std::memory_order_relaxed);
+            rect.maxY = maxY.load(std::memory_order_relaxed);
+        }
+
+        return rect;
+    }
+
+    //Read the rect and reset it to empty
+    DirtyRect Take() {
+        DirtyRect rect;
+
+        if (minX.load(std::memory_order_relaxed) != INT_MAX) {
+            rect.minX = minX.exchange(INT_MAX, std::memory_order_relaxed);
+            rect.minY = minY.exchange(INT_MAX, std::memory_order_relaxed);
+            rect.maxX = maxX.exchange(INT_MIN, std::memory_order_relaxed);
+            rect.maxY = maxY.exchange(INT_MIN, std::memory_order_relaxed);
+        }
+
+        return rect;
+    }
+
+private:
+    static void AtomicMin(std::atomic<int>& target, int value) {
+        int current = target.load(std::memory_order_relaxed);
+        while (value < current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+    }
+
+    static void AtomicMax(std::atomic<int>& target, int value) {
+        int current = target.load(std::memory_order_relaxed);
+        while (value > current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+    }
+};
+
+//CHUNK_SIZE x CHUNK_SIZE block of the grid. A chunk only gets updated inside the rect built from
+//last tick's changes, and sleeps (empty rect) until a change in or next to it wakes it again.
+//Inside the rect only the particles on the worklist (cell indices) get updated.
+struct Chunk {
+    DirtyRect rect; //Cells to update this tick
+    SharedRect nextRect; //Cells near a change this tick, updated next tick
+
+    std::vector<uint32_t> active; //Particles to update this tick
+    std::vector<uint32_t> nextActive; //Particles that changed or had a neighbor change this tick
+    SpinLock nextActiveLock; //Neighboring chunks can queue cells here from other threads
+
+    Rng rng; //Rolls for particles updated in this chunk
+};
+
+//World grid sized at startup, stored as two planes: the packed CellWords (state, wetness, velocity, queued flag)
+//and the combo timers. The planes share one cache aligned allocation and rows are padded out to
+//a whole number of cache lines, so a row of either plane starts on a line boundary. Cell is
+//still the value type for reading/writing a whole cell.
+class CellGrid {
+public:
+    CellGrid(int length, int width);
+    ~CellGrid();
+
+    CellGrid(const CellGrid&) = delete;
+    CellGrid& operator=(const CellGrid&) = delete;
+
+    int Length() const { return length; } //Rows (y)
+    int Width() const { return width; } //Columns (x)
+    int Stride() const { return stride; } //Cells between the start of two rows
+
+    size_t Index(int y, int x) const { return static_cast<size_t>(y) * stride + x; }
+
+    //Single field access. State writes go through SetState/Set/Swap so the material counts stay
+    //right, and every write leaves the queued flag (which belongs to the position) alone.
+    CellState State(int y, int x) const { return WordState(words[Index(y, x)]); }
+
+    //A new state starts at rest
+    void SetState(int y, int x, CellState state) {
+        CellWord& word = words[Index(y, x)];
+        CountChange(WordState(word), state);
+        word = static_cast<CellWord>((word & ~(WORD_STATE_MASK | WORD_VELOCITY_MASK)) | (static_cast<int>(state) << WORD_STATE_SHIFT));
+    }
+
+    uint8_t Wetness(int y, int x) const { return WordWetness(words[Index(y, x)]); }
+
+    void SetWetness(int y, int x, uint8_t wetness) {
+        CellWord& word = words[Index(y, x)];
+        word = static_cast<CellWord>((word & ~WORD_WETNESS_MASK) | wetness);
+    }
+
+    uint8_t Velocity(int y, int x) const { return WordVelocity(words[Index(y, x)]); }
+
+    void SetVelocity(int y, int x, uint8_t velocity) {
+        CellWord& word = words[Index(y, x)];
+        word = static_cast<CellWord>((word & ~WORD_VELOCITY_MASK) | (velocity << WORD_VELOCITY_SHIFT));
+    }
+
+    uint8_t& ComboTimer(int y, int x) { return comboTimers[Index(y, x)]; }
+    uint8_t ComboTimer(int y, int x) const { return comboTimers[Index(y, x)]; }
+
+    //Plane rows
+    CellWord* WordRow(int y) { return words + Index(y, 0); }
+    const CellWord* WordRow(int y) const { return words + Index(y, 0); }
+
+    uint8_t* ComboTimerRow(int y) { return comboTimers + Index(y, 0); }
+    const uint8_t* ComboTimerRow(int y) const { return comboTimers + Index(y, 0); }
+
+    //Whole cell access
+    Cell Get(int y, int x) const {
+        size_t i = Index(y, x);
+        return Cell{ WordState(words[i]), WordWetness(words[i]), comboTimers[i], WordVelocity(words[i]) };
+    }
+
+    //Empty cells are always at rest, MoveState relies on it
+    void Set(int y, int x, const Cell& cell) {
+        size_t i = Index(y, x);
+        uint8_t velocity = cell.state == CellState::EMPTY ? 0 : cell.velocity;
+
+        CountChange(WordState(words[i]), cell.state);
+        words[i] = static_cast<CellWord>((words[i] & ~WORD_PARTICLE_MASK) | MakeWord(cell.state, cell.wetness, velocity));
+        comboTimers[i] = cell.comboTimer;
+    }
+
+    //Moves don't change how much of anything there is, so no counting in these two.
+    //MoveState moves the state and velocity into an empty cell (wetness and timer stay put).
+    void MoveState(int y, int x, int Other_y, int Other_x) {
+        const CellWord Moving = WORD_STATE_MASK | WORD_VELOCITY_MASK;
+
+        CellWord& from = words[Index(y, x)];
+        CellWord& to = words[Index(Other_y, Other_x)];
+
+        to = static_cast<CellWord>(to | (from & Moving));
+        from = static_cast<CellWord>(from & ~Moving);
+    }
+
+    void Swap(int y, int x, int Other_y, int Other_x) {
+        size_t i = Index(y, x);
+        size_t j = Index(Other_y, Other_x);
+
+        CellWord moved = static_cast<CellWord>((words[i] ^ words[j]) & WORD_PARTICLE_MASK);
+        words[i] ^= moved;
+        words[j] ^= moved;
+
+        std::swap(comboTimers[i], comboTimers[j]);
+    }
+
+    //Cells of a material in the grid, kept up to date on every state change
+    int64_t MaterialCount(CellState state) const { return materialCounts[static_cast<int>(state)].load(std::memory_order_relaxed); }
+
+    bool InBounds(int y, int x) const { return x >= 0 && x < width && y >= 0 && y < length; }
+
+    //Chunks
+    int ChunksX() const { return chunksX; }
+    int ChunksY() const { return chunksY; }
+
+    Chunk& GetChunk(int cy, int cx) { return chunks[static_cast<size_t>(cy) * chunksX + cx]; }
+    Chunk& GetChunk(int index) { return chunks[index]; }
+    const Chunk& GetChunk(int index) const { return chunks[index]; }
+
+    void WakeCell(int y, int x) { WakeRect(y - 1, x - 1, y + 1, x + 1); } //Cell changed, update it and its neighbors next tick
+    void KeepAwake(int y, int x) { WakeRect(y, x, y, x); } //Update just this cell again next tick
+    void WakeRect(int minY, int minX, int maxY, int maxX); //Update the cells in the (inclusive) rect next tick
+    void WakeAll();
+    void ClearWake(); //Drop every pending update and redraw everything, for when all cells were replaced
+    void BeginTick(); //Move the rects built last tick into place for this one
+
+    //Put back a pending update saved with a world (after ClearWake): a chunk's next tick rect, and
+    //the cells on its worklist. Queued as they were, even cells whose particle has since moved on.
+    void RestoreWake(int chunk, const DirtyRect& rect);
+    void RestoreQueued(int y, int x);
+    bool Queued(int y, int x) const { return (words[Index(y, x)] & WORD_QUEUED) != 0; }
+
+    //Cells that may have changed since the last call, for redrawing only what changed.
+    //Built from the wake rects, so it's a (slightly larger) superset of the changed cells.
+    //Not safe to call while an update is running.
+    DirtyRect TakeRenderDirty();
+
+private:
+    //Relaxed atomics, reactions in chunks on different threads can change counts at the same time
+    void CountChange(CellState from, CellState to) {
+        if (from == to) return;
+
+        materialCounts[static_cast<int>(from)].fetch_sub(1, std::memory_order_relaxed);
+        materialCounts[static_cast<int>(to)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    uint8_t* memory = nullptr; //Backing allocation for all the planes
+
+    CellWord* words = nullptr;
+    uint8_t* comboTimers = nullptr;
+
+    std::unique_ptr<Chunk[]> chunks;
+    DirtyRect renderDirty; //Rects of the ticks run since the last TakeRenderDirty
+    SharedRect edgeDirty; //Changes on the outer ring since the last TakeRenderDirty, no chunk rect reaches them
+    std::atomic<int64_t> materialCounts[NUM_MATERIALS] = {};
+    int chunksX = 0;
+    int chunksY = 0;
+
+    int length = 0;
+    int width = 0;
+    int stride = 0;
+};
@@ -0,0 +1,308 @@
+// C++ Standard Libraries
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <cstdint>
+#include <chrono>
+#include <thread>
+#include <random>
+#include <algorithm>
+
+#include "constants.h"
+#include "grid.h"
+#include "simulation.h"
+#include "scenes.h"
+#include "worldfile.h"
+#include "replay.h"
+#include "trace.h"
+#include "world.h"
+
+//Runs the simulation without a window: build a scene, run a number of ticks as fast as
+//possible and report the speed. Same seed, scene and size give the same checksum.
+
+#pragma region Global Variables
+
+int GridLength = GRID_LENGTH;
+int GridWidth = GRID_WIDTH;
+int Ticks = 1000;
+int UpdateThreads = std::max(1, (int)std::thread::hardware_concurrency());
+uint64_t SimSeed = std::random_device{}();
+std::string SceneName = "sand-into-water";
+bool SceneGiven = false; //--scene was passed, not just the default
+std::string LoadPath; //World file to start from instead of a scene
+std::string SavePath; //Save the world here after the run
+std::string ReplayPath; //Recorded session to play back instead of a scene
+std::string TracePath; //Export the trace here after the run (SANDMAKER_TRACE builds)
+std::string WorldPath; //Sparse world directory, the grid is the window onto it
+bool CheckDirty = false; //Check every tick that the render dirty rect covers every changed cell
+
+#pragma endregion
+
+#pragma region Helper Functions
+
+void PrintUsage() {
+    std::cout << "Usage: sandheadless [--length N] [--width N] [--ticks N] [--threads N] [--seed N] [--scene NAME]\n";
+    std::cout << "                    [--load FILE] [--save FILE] [--replay FILE] [--trace FILE] [--world DIR]\n";
+    std::cout << "                    [--check-dirty]\n";
+    std::cout << "Scenes:";
+
+    for (const std::string& name : GetSceneNames()) {
+        std::cout << " " << name;
+    }
+
+    std::cout << "\n";
+}
+
+bool ParseArgs(int argc, char* argv[]) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+
+        if (arg == "--help" || arg == "-h") return false;
+
+        if (arg == "--check-dirty") {
+            CheckDirty = true;
+            continue;
+        }
+
+        if (i + 1 >= argc) {
+            std::cout << "Missing value for " << arg << "\n";
+            return false;
+        }
+
+        std::string value = argv[++i];
+
+        if (arg == "--length") GridLength = std::max(3, std::atoi(value.c_str()));
+        else if (arg == "--width") GridWidth = std::max(3, std::atoi(value.c_str()));
+        else if (arg == "--ticks") Ticks = std::max(0, std::atoi(value.c_str()));
+        else if (arg == "--threads") UpdateThreads = std::max(1, std::atoi(value.c_str()));
+        else if (arg == "--seed") SimSeed = std::strtoull(value.c_str(), nullptr, 10);
+        else if (arg == "--scene") {
+            SceneName = value;
+            SceneGiven = true;
+        }
+        else if (arg == "--load") LoadPath = value;
+        else if (arg == "--save") SavePath = value;
+        else if (arg == "--replay") ReplayPath = value;
+        else if (arg == "--trace") TracePath = value;
+        else if (arg == "--world") WorldPath = value;
+        else {
+            std::cout << "Unknown option " << arg << "\n";
+            return false;
+        }
+    }
+
+    //Each of these picks the starting world
+    if (!ReplayPath.empty() && (SceneGiven || !LoadPath.empty())) {
+        std::cout << "--replay starts from the recording's own world, it can't be combined with --scene or --load\n";
+        return false;
+    }
+
+    if (SceneGiven && !LoadPath.empty()) {
+        std::cout << "--scene and --load both pick the starting world, pass only one\n";
+        return false;
+    }
+
+    return true;
+}
+
+//What a redraw would show of every cell
+void SnapshotCells(const CellGrid& Grid, std::vector<CellWord>& cells) {
+    cells.resize(static_cast<size_t>(Grid.Length()) * Grid.Width());
+
+    for (int y = 0; y < Grid.Length(); y++) {
+        const CellWord* words = Grid.WordRow(y);
+
+        for (int x = 0; x < Grid.Width(); x++) {
+            cells[static_cast<size_t>(y) * Grid.Width() + x] = words[x] & WORD_CELL_MASK;
+        }
+    }
+}
+
+//Cells that changed since the snapshot but lie outside the dirty rect, the view would never redraw them
+int64_t CountMissedCells(const CellGrid& Grid, const std::vector<CellWord>& cells, const DirtyRect& dirty) {
+    int64_t missed = 0;
+
+    for (int y = 0; y < Grid.Length(); y++) {
+        const CellWord* words = Grid.WordRow(y);
+
+        for (int x = 0; x < Grid.Width(); x++) {
+            bool changed = (words[x] & WORD_CELL_MASK) != cells[static_cast<size_t>(y) * Grid.Width() + x];
+            bool covered = x >= dirty.minX && x <= dirty.maxX && y >= dirty.minY && y <= dirty.maxY;
+
+            if (changed && !covered) missed++;
+        }
+    }
+
+    return missed;
+}
+
+#pragma endregion
+
+int main(int argc, char* argv[]) {
+    SAND_TRACE_THREAD("Main");
+
+    if (!ParseArgs(argc, argv)) {
+        PrintUsage();
+        return 1;
+    }
+
+    std::string error;
+    Recording Session;
+
+    //A recording brings its own size and seed, and starts from an empty world like the app does
+    if (!ReplayPath.empty()) {
+        if (!LoadRecording(ReplayPath, Session, error)) {
+            std::cout << "Replay failed: " << error << "\n";
+            return 1;
+        }
+
+        GridLength = Session.length;
+        GridWidth = Session.width;
+        SimSeed = Session.seed;
+        Ticks = static_cast<int>(Session.endTick);
+        SceneName = ReplayPath;
+    }
+
+    //A world file brings its own size
+    else if (!LoadPath.empty() && !ReadWorldSize(LoadPath, GridLength, GridWidth, error)) {
+        std::cout << "Load failed: " << error << "\n";
+        return 1;
+    }
+
+    CellGrid Grid(GridLength, GridWidth);
+
+    InitializeSim(Grid, SimSeed);
+    SetUpdateThreads(UpdateThreads);
+
+    //A new world starts from the scene, one that has chunks on disk carries on from them
+    bool WorldStored = false;
+
+    if (!WorldPath.empty()) {
+        if (!OpenWorld(Grid, WorldPath, error)) {
+            std::cout << "World failed: " << error << "\n";
+            return 1;
+        }
+
+        WorldStored = GetWorldStats().chunksOnDisk > 0;
+    }
+
+    //Replays start from the empty world InitializeSim left (or the sparse world's window)
+    if (ReplayPath.empty()) {
+        if (WorldStored) {
+            if (SceneGiven || !LoadPath.empty()) std::cout << "Ignoring --scene/--load, " << WorldPath << " already has chunks\n";
+
+            SceneName = WorldPath;
+        }
+
+        else if (!LoadPath.empty()) {
+            auto loadStart = std::chrono::steady_clock::now();
+
+            if (!LoadWorld(LoadPath, Grid, error)) {
+                std::cout << "Load failed: " << error << "\n";
+                return 1;
+            }
+
+            double loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count();
+            std::cout << "Loaded " << LoadPath << " in " << loadMs << " ms\n";
+
+            SceneName = LoadPath;
+        }
+
+        else if (!BuildScene(Grid, SceneName)) {
+            std::cout << "Unknown scene " << SceneName << "\n";
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    std::cout << "Scene: " << SceneName << ", Grid: " << GridLength << "x" << GridWidth
+        << ", Threads: " << UpdateThreads << ", Seed: " << SimSeed << "\n";
+
+    int64_t StartCounts[NUM_MATERIALS];
+    for (int material = 0; material < NUM_MATERIALS; material++) {
+        StartCounts[material] = Grid.MaterialCount(static_cast<CellState>(material));
+    }
+
+    BrushInput Brush;
+    Replayer Player(Session);
+
+    std::vector<CellWord> Snapshot;
+    int64_t MissedCells = 0;
+
+    //Start the checks from a clean slate, the scene itself is drawn in full anyway
+    if (CheckDirty) Grid.TakeRenderDirty();
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int tick = 0; tick < Ticks; tick++) {
+        if (CheckDirty) SnapshotCells(Grid, Snapshot);
+
+        Player.Apply(tick, Grid, Brush);
+        UpdateGrid(Grid, Brush);
+
+        if (CheckDirty) MissedCells += CountMissedCells(Grid, Snapshot, Grid.TakeRenderDirty());
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double ticksPerSecond = seconds > 0 ? Ticks / seconds : 0;
+
+    std::cout << "Ticks: " << Ticks << " in " << seconds << " s\n";
+    std::cout << "Ticks/sec: " << ticksPerSecond << "\n";
+    std::cout << "Cells/sec: " << ticksPerSecond * GridLength * GridWidth << "\n";
+    std::cout << "Checksum: " << std::hex << GridChecksum(Grid) << std::dec << "\n";
+
+    //Cells of each material at the end, and how that changed over the run
+    std::cout << "Materials:";
+
+    for (int material = 0; material < NUM_MATERIALS; material++) {
+        int64_t count = Grid.MaterialCount(static_cast<CellState>(material));
+        int64_t change = count - StartCounts[material];
+
+        std::cout << " " << CellStateToString(static_cast<CellState>(material)) << " " << count << " (" << (change >= 0 ? "+" : "") << change << ")";
+    }
+
+    std::cout << "\n";
+
+    if (CheckDirty) {
+        std::cout << "Render dirty: " << (MissedCells == 0 ? "covers every change" : std::to_string(MissedCells) + " changed cells missed") << "\n";
+
+        if (MissedCells > 0) return 3;
+    }
+
+    if (!ReplayPath.empty()) {
+        bool match = GridChecksum(Grid) == Session.checksum;
+        std::cout << "Replay: " << (match ? "matches the recording" : "differs from the recording") << "\n";
+
+        if (!match) return 2;
+    }
+
+    if (WorldOpen()) {
+        if (!FlushWorld(Grid, error)) {
+            std::cout << "World save failed: " << error << "\n";
+            return 1;
+        }
+
+        WorldStats Stats = GetWorldStats();
+        std::cout << "World: " << Stats.chunksOnDisk << " chunks in " << WorldPath << "\n";
+    }
+
+    if (!SavePath.empty()) {
+        if (!SaveWorld(SavePath, Grid, error)) {
+            std::cout << "Save failed: " << error << "\n";
+            return 1;
+        }
+
+        std::cout << "Saved " << SavePath << "\n";
+    }
+
+    if (!TracePath.empty()) {
+        if (!ExportTrace(TracePath, error)) {
+            std::cout << "Trace export failed: " << error << "\n";
+            return 1;
+        }
+
+        std::cout << "Trace written to " << TracePath << "\n";
+    }
+
+    return 0;
+}
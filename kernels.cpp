@@ -0,0 +1,129 @@
+#include "kernels.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define KERNELS_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define KERNELS_SSE2
+#endif
+
+static_assert(static_cast<int>(CellState::EMPTY) == 0, "ClearEmptyWetness compares the state bits against zero");
+
+#pragma region Combo Timers
+
+bool DecrementComboTimers(uint8_t* timers, int count) {
+    int i = 0;
+    uint8_t running = 0;
+
+#if defined(KERNELS_AVX2)
+    const __m256i ones = _mm256_set1_epi8(1);
+    __m256i any = _mm256_setzero_si256();
+
+    for (; i + 32 <= count; i += 32) {
+        __m256i t = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(timers + i));
+        any = _mm256_or_si256(any, t);
+
+        //Saturating subtract leaves finished timers at zero
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(timers + i), _mm256_subs_epu8(t, ones));
+    }
+
+    running = !_mm256_testz_si256(any, any);
+#elif defined(KERNELS_SSE2)
+    const __m128i ones = _mm_set1_epi8(1);
+    __m128i any = _mm_setzero_si128();
+
+    for (; i + 16 <= count; i += 16) {
+        __m128i t = _mm_loadu_si128(reinterpret_cast<const __m128i*>(timers + i));
+        any = _mm_or_si128(any, t);
+
+        //Saturating subtract leaves finished timers at zero
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(timers + i), _mm_subs_epu8(t, ones));
+    }
+
+    running = _mm_movemask_epi8(_mm_cmpeq_epi8(any, _mm_setzero_si128())) != 0xFFFF;
+#endif
+
+    for (; i < count; i++) {
+        running |= timers[i];
+
+        if (timers[i] > 0) {
+            timers[i]--;
+        }
+    }
+
+    return running != 0;
+}
+
+#pragma endregion
+
+#pragma region Wetness
+
+void ClearEmptyWetness(CellWord* words, int count) {
+    int i = 0;
+
+#if defined(KERNELS_AVX2)
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i stateMask = _mm256_set1_epi16(static_cast<short>(WORD_STATE_MASK));
+    const __m256i wetnessMask = _mm256_set1_epi16(static_cast<short>(WORD_WETNESS_MASK));
+
+    for (; i + 16 <= count; i += 16) {
+        __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + i));
+
+        //Wetness bits of the empty cells
+        __m256i empty = _mm256_cmpeq_epi16(_mm256_and_si256(w, stateMask), zero);
+        __m256i clear = _mm256_and_si256(empty, wetnessMask);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(words + i), _mm256_andnot_si256(clear, w));
+    }
+#elif defined(KERNELS_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i stateMask = _mm_set1_epi16(static_cast<short>(WORD_STATE_MASK));
+    const __m128i wetnessMask = _mm_set1_epi16(static_cast<short>(WORD_WETNESS_MASK));
+
+    for (; i + 8 <= count; i += 8) {
+        __m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(words + i));
+
+        //Wetness bits of the empty cells
+        __m128i empty = _mm_cmpeq_epi16(_mm_and_si128(w, stateMask), zero);
+        __m128i clear = _mm_and_si128(empty, wetnessMask);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(words + i), _mm_andnot_si128(clear, w));
+    }
+#endif
+
+    for (; i < count; i++) {
+        if ((words[i] & WORD_STATE_MASK) == 0) {
+            words[i] &= ~WORD_WETNESS_MASK;
+        }
+    }
+}
+
+#pragma endregion
+
+#pragma region Palette
+
+static_assert(PALETTE_WETNESS_LEVELS == 1 << WORD_STATE_SHIFT, "GatherPalette uses the state and wetness bits as the palette index");
+
+void GatherPalette(const CellWord* words, const uint32_t* palette, uint32_t* out, int count) {
+    int i = 0;
+
+#if defined(KERNELS_AVX2)
+    const __m256i cellMask = _mm256_set1_epi32(WORD_CELL_MASK);
+
+    for (; i + 8 <= count; i += 8) {
+        __m256i w = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(words + i)));
+
+        __m256i index = _mm256_and_si256(w, cellMask);
+        __m256i pixels = _mm256_i32gather_epi32(reinterpret_cast<const int*>(palette), index, 4);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), pixels);
+    }
+#endif
+
+    for (; i < count; i++) {
+        out[i] = palette[words[i] & WORD_CELL_MASK];
+    }
+}
+
+#pragma endregion
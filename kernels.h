@@ -0,0 +1,20 @@
+#pragma once
+// C++ Standard Libraries
+#include <cstdint>
+
+#include "grid.h"
+
+//Bulk per cell passes over a span of one grid plane row. Built for AVX2 or SSE2 when the
+//compiler targets them (/arch:AVX2, -mavx2, any x64 build for SSE2), scalar otherwise.
+
+//Count every running combo timer down by one, returns true if any timer in the span was running
+bool DecrementComboTimers(uint8_t* timers, int count);
+
+//Dry out every EMPTY cell in the span
+void ClearEmptyWetness(CellWord* words, int count);
+
+//Palette entries per material, one for every value of the byte below the state bits
+const int PALETTE_WETNESS_LEVELS = 1 << WORD_STATE_SHIFT;
+
+//out[i] = palette[words[i] & WORD_CELL_MASK] (state * PALETTE_WETNESS_LEVELS + wetness), one packed pixel per cell
+void GatherPalette(const CellWord* words, const uint32_t* palette, uint32_t* out, int count);
@@ -0,0 +1,278 @@
+#include "leveling.h"
+
+// C++ Standard Libraries
+#include <vector>
+#include <algorithm>
+
+#include "materials.h"
+#include "trace.h"
+
+#pragma region Script Variables
+
+const int CHUNK_CELLS = CHUNK_SIZE * CHUNK_SIZE;
+
+//Union-find over the cells of the included chunks, CHUNK_CELLS entries per chunk in the order the
+//chunks were included (see Slot). Only the entries of labeled cells (resting liquid in the interior
+//of an included chunk) are written each pass, nothing else is ever read.
+std::vector<uint32_t> Parent;
+
+std::vector<int> ChunkSlot; //Per chunk, its place in IncludedChunks this pass, -1 when not included
+std::vector<int> IncludedChunks;
+std::vector<int> Wave; //Chunks to label next
+std::vector<int> NextWave;
+
+struct Surface {
+    uint32_t body; //Root slot of the body
+    int y, x; //Top cell of a column, with empty space above it
+};
+
+std::vector<Surface> Surfaces;
+
+#pragma endregion
+
+#pragma region Helper Functions
+
+//Liquid that isn't falling, falling cells are left to the kernels
+inline bool IsResting(CellWord word) {
+    return IsLiquid(WordState(word)) && WordVelocity(word) == 0;
+}
+
+inline bool SameBody(CellWord a, CellWord b) {
+    return IsResting(a) && IsResting(b) && WordState(a) == WordState(b);
+}
+
+//Union-find entry of a cell in an included chunk
+inline uint32_t Slot(int y, int x, int chunkSlot) {
+    return static_cast<uint32_t>(chunkSlot * CHUNK_CELLS + (y % CHUNK_SIZE) * CHUNK_SIZE + x % CHUNK_SIZE);
+}
+
+inline uint32_t Slot(const CellGrid& Grid, int y, int x) {
+    return Slot(y, x, ChunkSlot[(y / CHUNK_SIZE) * Grid.ChunksX() + x / CHUNK_SIZE]);
+}
+
+//Put a chunk on the included list, Parent grows to cover it
+void IncludeChunk(int chunk) {
+    ChunkSlot[chunk] = static_cast<int>(IncludedChunks.size());
+    IncludedChunks.push_back(chunk);
+
+    Parent.resize(IncludedChunks.size() * CHUNK_CELLS);
+}
+
+//Path halving, only touches cells of the body it's called on
+uint32_t Find(uint32_t i) {
+    while (Parent[i] != i) {
+        Parent[i] = Parent[Parent[i]];
+        i = Parent[i];
+    }
+
+    return i;
+}
+
+//The lowest slot is always the root, so the labels don't depend on the order bodies were joined in
+void Union(uint32_t a, uint32_t b) {
+    a = Find(a);
+    b = Find(b);
+
+    if (a < b) Parent[b] = a;
+    else if (b < a) Parent[a] = b;
+}
+
+//Interior cells of a chunk (the outer ring of the grid is never updated)
+void ChunkArea(const CellGrid& Grid, int chunk, int& y0, int& x0, int& y1, int& x1) {
+    int cy = chunk / Grid.ChunksX();
+    int cx = chunk % Grid.ChunksX();
+
+    y0 = std::max(cy * CHUNK_SIZE, 1);
+    x0 = std::max(cx * CHUNK_SIZE, 1);
+    y1 = std::min((cy + 1) * CHUNK_SIZE, Grid.Length() - 1) - 1;
+    x1 = std::min((cx + 1) * CHUNK_SIZE, Grid.Width() - 1) - 1;
+}
+
+//Label the bodies inside one chunk, only reads and writes that chunk's cells
+void LabelChunk(const CellGrid& Grid, int chunk) {
+    int y0, x0, y1, x1;
+    ChunkArea(Grid, chunk, y0, x0, y1, x1);
+
+    int chunkSlot = ChunkSlot[chunk];
+
+    for (int y = y0; y <= y1; y++) {
+        const CellWord* Row = Grid.WordRow(y);
+        const CellWord* Above = Grid.WordRow(y - 1);
+
+        for (int x = x0; x <= x1; x++) {
+            if (!IsResting(Row[x])) continue;
+
+            uint32_t i = Slot(y, x, chunkSlot);
+            Parent[i] = i;
+
+            if (x > x0 && SameBody(Row[x], Row[x - 1])) Union(i, i - 1);
+            if (y > y0 && SameBody(Row[x], Above[x])) Union(i, i - CHUNK_SIZE);
+        }
+    }
+}
+
+//Does a body cross the edge between two chunks, (dy, dx) is the step from chunk to neighbor
+bool CrossesEdge(const CellGrid& Grid, int chunk, int dy, int dx, bool join) {
+    int y0, x0, y1, x1;
+    ChunkArea(Grid, chunk, y0, x0, y1, x1);
+
+    //Cells along the edge on this side
+    int ey0 = dy > 0 ? y1 : y0, ey1 = dy < 0 ? y0 : y1;
+    int ex0 = dx > 0 ? x1 : x0, ex1 = dx < 0 ? x0 : x1;
+
+    bool crosses = false;
+
+    for (int y = ey0; y <= ey1; y++) {
+        for (int x = ex0; x <= ex1; x++) {
+            int ny = y + dy, nx = x + dx;
+            if (ny < 1 || nx < 1 || ny > Grid.Length() - 2 || nx > Grid.Width() - 2) continue;
+
+            if (!SameBody(Grid.WordRow(y)[x], Grid.WordRow(ny)[nx])) continue;
+
+            if (!join) return true;
+
+            Union(Slot(Grid, y, x), Slot(Grid, ny, nx));
+            crosses = true;
+        }
+    }
+
+    return crosses;
+}
+
+//Move up to count cells off the top of the from column onto the to column
+void MoveSurface(CellGrid& Grid, const Surface& from, const Surface& to, int count) {
+    CellState State = Grid.State(from.y, from.x);
+
+    for (int step = 0; step < count; step++) {
+        int From_y = from.y + step;
+        int To_y = to.y - 1 - step;
+
+        if (To_y < 1 || Grid.State(To_y, to.x) != CellState::EMPTY) return;
+        if (Grid.State(From_y, from.x) != State || Grid.Velocity(From_y, from.x) != 0) return;
+
+        Grid.MoveState(From_y, from.x, To_y, to.x);
+
+        Grid.WakeCell(From_y, from.x);
+        Grid.WakeCell(To_y, to.x);
+    }
+}
+
+#pragma endregion
+
+#pragma region Leveling
+
+void LevelLiquids(CellGrid& Grid, ThreadPool& Pool) {
+    SAND_TRACE_SCOPE("LevelLiquids");
+
+    int ChunkCount = Grid.ChunksX() * Grid.ChunksY();
+
+    //Only the chunks included last pass need clearing
+    if (static_cast<int>(ChunkSlot.size()) != ChunkCount) {
+        ChunkSlot.assign(ChunkCount, -1);
+    }
+
+    else {
+        for (int chunk : IncludedChunks) ChunkSlot[chunk] = -1;
+    }
+
+    IncludedChunks.clear();
+    Parent.clear();
+    Wave.clear();
+
+    //Start from the chunks that updated this tick
+    for (int chunk = 0; chunk < ChunkCount; chunk++) {
+        if (!Grid.GetChunk(chunk).rect.Empty()) {
+            IncludeChunk(chunk);
+            Wave.push_back(chunk);
+        }
+    }
+
+    const int Steps[4][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+    int Pulled = 0; //Sleeping chunks included so far
+
+    //Label a wave of chunks at a time, and pull in the sleeping chunks the bodies run into
+    while (!Wave.empty()) {
+        Pool.ParallelFor(static_cast<int>(Wave.size()), [&Grid](int i) {
+            LabelChunk(Grid, Wave[i]);
+        });
+
+        NextWave.clear();
+
+        for (int chunk : Wave) {
+            int cy = chunk / Grid.ChunksX();
+            int cx = chunk % Grid.ChunksX();
+
+            for (const auto& Step : Steps) {
+                int ny = cy + Step[0], nx = cx + Step[1];
+                if (ny < 0 || nx < 0 || ny >= Grid.ChunksY() || nx >= Grid.ChunksX()) continue;
+
+                int neighbor = ny * Grid.ChunksX() + nx;
+
+                if (Pulled < LEVEL_MAX_SLEEPING_CHUNKS && ChunkSlot[neighbor] < 0 && CrossesEdge(Grid, chunk, Step[0], Step[1], false)) {
+                    IncludeChunk(neighbor);
+                    NextWave.push_back(neighbor);
+                    Pulled++;
+                }
+            }
+        }
+
+        Wave.swap(NextWave);
+    }
+
+    //Join the bodies across chunk edges, each edge once (from the chunk on its right/bottom side)
+    for (int chunk : IncludedChunks) {
+        int cy = chunk / Grid.ChunksX();
+        int cx = chunk % Grid.ChunksX();
+
+        if (cx > 0 && ChunkSlot[chunk - 1] >= 0) CrossesEdge(Grid, chunk, 0, -1, true);
+        if (cy > 0 && ChunkSlot[chunk - Grid.ChunksX()] >= 0) CrossesEdge(Grid, chunk, -1, 0, true);
+    }
+
+    //Every column top with air above it
+    Surfaces.clear();
+
+    for (int chunk : IncludedChunks) {
+        int y0, x0, y1, x1;
+        ChunkArea(Grid, chunk, y0, x0, y1, x1);
+
+        for (int y = std::max(y0, 2); y <= y1; y++) {
+            const CellWord* Row = Grid.WordRow(y);
+            const CellWord* Above = Grid.WordRow(y - 1);
+
+            for (int x = x0; x <= x1; x++) {
+                if (IsResting(Row[x]) && WordState(Above[x]) == CellState::EMPTY) {
+                    Surfaces.push_back({ Find(Slot(Grid, y, x)), y, x });
+                }
+            }
+        }
+    }
+
+    //Per body, highest surface first
+    std::sort(Surfaces.begin(), Surfaces.end(), [](const Surface& a, const Surface& b) {
+        if (a.body != b.body) return a.body < b.body;
+        if (a.y != b.y) return a.y < b.y;
+        return a.x < b.x;
+    });
+
+    size_t BodyStart = 0;
+
+    while (BodyStart < Surfaces.size()) {
+        size_t BodyEnd = BodyStart;
+        while (BodyEnd < Surfaces.size() && Surfaces[BodyEnd].body == Surfaces[BodyStart].body) BodyEnd++;
+
+        //Highest with lowest, inwards until the rest are within a cell of each other
+        size_t High = BodyStart;
+        size_t Low = BodyEnd - 1;
+
+        while (High < Low && Surfaces[Low].y - Surfaces[High].y >= 2) {
+            MoveSurface(Grid, Surfaces[High], Surfaces[Low], (Surfaces[Low].y - Surfaces[High].y) / 2);
+
+            High++;
+            Low--;
+        }
+
+        BodyStart = BodyEnd;
+    }
+}
+
+#pragma endregion
@@ -0,0 +1,21 @@
+#pragma once
+#include "grid.h"
+#include "threadpool.h"
+
+//Liquid leveling. Left to the move kernels, a body of water only flattens by particles on its
+//surface wandering sideways a few cells at a time, which takes thousands of ticks in a wide tank
+//and keeps the whole surface awake while it does.
+//
+//After each tick's update the resting (velocity 0) liquid cells in awake chunks are labeled into
+//connected bodies with union-find, a chunk per job. The labeling follows a body into the sleeping
+//chunks it reaches, nearest first, but pulls in at most LEVEL_MAX_SLEEPING_CHUNKS of them a tick,
+//so a drip into a large lake costs the same as one into a puddle. Then, per body, surface cells are
+//moved from the highest columns straight onto the lowest: the highest surface pairs with the
+//lowest, the second highest with the second lowest and so on, each pair evening out by half its
+//height difference. The chunks that receive cells are awake next tick, so leveling carries on
+//outwards through a body bigger than the cap. A disturbed body is level within a few ticks and can
+//go back to sleep, a body that isn't disturbed costs nothing.
+
+const int LEVEL_MAX_SLEEPING_CHUNKS = 16; //Sleeping chunks a tick's labeling can pull in
+
+void LevelLiquids(CellGrid& Grid, ThreadPool& Pool);
@@ -1,5 +1,4 @@
 #define SDL_MAIN_HANDLED
-#define NUM_MATERIALS 6
 
 // C++ Standard Libraries
 #include <iostream>
@@ -7,6 +6,10 @@
 #include <algorithm>
 #include <string>
 #include <thread>
+#include <cstdlib>
+#include <random>
+#include <sstream>
+#include <iomanip>
 
 // Third Party
 #include <SDL.h>
@@ -14,6 +17,11 @@
 
 // Other scripts
 #include "simulation.h"
+#include "view.h"
+#include "replay.h"
+#include "profiler.h"
+#include "trace.h"
+#include "world.h"
 #include "constants.h"
 #include "UiManager.h"
 
@@ -29,11 +37,6 @@ Uint32 fpsLastTime = SDL_GetTicks();
 Uint32 lastTime = SDL_GetTicks();
 Uint32 frameStart;
 
-//deltatime stuff
-float accumulator = 0.0f;
-Uint64 now = SDL_GetPerformanceCounter();
-Uint64 last = now;
-
 //UI stuff
 UiManager _UiManager;
 Theme theme;
@@ -43,6 +46,29 @@ bool LmbHeld = false;
 
 int selectionvalue = 1;
 
+//Cells of each material, from the newest snapshot
+int64_t MaterialCounts[NUM_MATERIALS] = {};
+
+//Frame profiler overlay, one line per phase, refreshed with the FPS counter
+std::string ProfileLines[NUM_FRAME_PHASES];
+const char* const PROFILE_CSV_PATH = "profile.csv"; //F2 dumps the profiler window here
+const char* const TRACE_PATH = "trace.json"; //F3 exports the trace here (SANDMAKER_TRACE builds)
+
+//Grid size and update threads, set at startup
+int GridLength = GRID_LENGTH;
+int GridWidth = GRID_WIDTH;
+int UpdateThreads = std::max(1, (int)std::thread::hardware_concurrency());
+uint64_t SimSeed = std::random_device{}();
+
+//Session recording, --record writes one on exit and --replay plays one back
+std::string RecordPath;
+std::string ReplayPath;
+
+std::string WorldPath; //Sparse world directory, --world opens it with the grid as the window
+
+//Left edge of the sidebar, just past the grid
+int SidebarX = CELL_SIZE * GRID_WIDTH;
+
 #pragma endregion
 
 #pragma region Color Picker Window
@@ -57,6 +83,8 @@ void ColorPickerUI(UiManager &_UM, SDL_Color &OG_Col) {
 }
 
 void ColorPickerWindow() {
+    SAND_TRACE_THREAD("Color picker");
+
     UiManager _colorPickerUI;
     SDL_Color OG_Col;
 
@@ -78,6 +106,8 @@ void ColorPickerWindow() {
     ColorPickerUI(_colorPickerUI, OG_Col);
 
     while (PickerOpen) {
+        SAND_TRACE_SCOPE("ColorPicker frame");
+
         SDL_Event ev;
         LmbHeld = false;
 
@@ -114,6 +144,36 @@ void ColorPickerWindow() {
 
 #pragma endregion
 
+#pragma region Profiler
+
+void RefreshProfileLines() {
+    for (int phase = 0; phase < NUM_FRAME_PHASES; phase++) {
+        PhaseStats stats = GetProfiler().Stats(static_cast<FramePhase>(phase));
+
+        std::ostringstream line;
+        line << std::fixed << std::setprecision(2) << FramePhaseName(static_cast<FramePhase>(phase)) << ": "
+            << stats.p50 << " " << stats.p95 << " " << stats.p99 << " " << stats.max;
+
+        ProfileLines[phase] = line.str();
+    }
+}
+
+void DumpProfile() {
+    std::string error;
+
+    if (GetProfiler().DumpCsv(PROFILE_CSV_PATH, error)) std::cout << "Frame times written to " << PROFILE_CSV_PATH << "\n";
+    else std::cout << "Profile dump failed: " << error << "\n";
+}
+
+void DumpTrace() {
+    std::string error;
+
+    if (ExportTrace(TRACE_PATH, error)) std::cout << "Trace written to " << TRACE_PATH << "\n";
+    else std::cout << "Trace export failed: " << error << "\n";
+}
+
+#pragma endregion
+
 #pragma region Set Up Functions
 
 void InitializeTheme(TTF_Font* DefaultFont, TTF_Font* HeadingFont) {
@@ -147,43 +207,134 @@ void SetUpUI() {
         }, CELL_SIZE * 3, CELL_SIZE * 3);
 
     //Sidebar
-    _UiManager.AddText("Particle Settings", CELL_SIZE * 156.5, CELL_SIZE * 3, true);
-    _UiManager.AddText("Material Settings", CELL_SIZE * 155, CELL_SIZE * 14);
+    _UiManager.AddText("Particle Settings", SidebarX + CELL_SIZE * 6.5, CELL_SIZE * 3, true);
+    _UiManager.AddText("Material Settings", SidebarX + CELL_SIZE * 5, CELL_SIZE * 14);
 
-    _UiManager.AddDropdown("Current Material", CELL_SIZE * 155, CELL_SIZE * 21, CELL_SIZE * 50, CELL_SIZE * 7, GetAddableMaterials(), ([=](int selectedIndex) {
+    _UiManager.AddDropdown("Current Material", SidebarX + CELL_SIZE * 5, CELL_SIZE * 21, CELL_SIZE * 50, CELL_SIZE * 7, GetAddableMaterials(), ([=](int selectedIndex) {
         std::cout << "Selected: " << selectedIndex << "\n";
         Switch_Material(selectedIndex);
     }));
 
-    _UiManager.AddText("Material Color: ", CELL_SIZE * 155, CELL_SIZE * 32);
+    _UiManager.AddText("Material Color: ", SidebarX + CELL_SIZE * 5, CELL_SIZE * 32);
 
-    _UiManager.AddButton("Change", CELL_SIZE * 196.5, CELL_SIZE * 32, CELL_SIZE * 18, CELL_SIZE * 7, [] {
+    _UiManager.AddButton("Change", SidebarX + CELL_SIZE * 46.5, CELL_SIZE * 32, CELL_SIZE * 18, CELL_SIZE * 7, [] {
             std::thread pickerThread([]() {
                 ColorPickerWindow();
                 });
             pickerThread.detach();
         });
 
-    _UiManager.AddColoredBox(CELL_SIZE * 186, CELL_SIZE * 32, CELL_SIZE * 8, CELL_SIZE * 7, [&]() {
+    _UiManager.AddColoredBox(SidebarX + CELL_SIZE * 36, CELL_SIZE * 32, CELL_SIZE * 8, CELL_SIZE * 7, [&]() {
         return Get_Curr_Color();
         });
 
     _UiManager.AddText([&]() {
         return "Brush Size: " + std::to_string(selectionvalue);
-        }, CELL_SIZE * 155, CELL_SIZE * 42);
+        }, SidebarX + CELL_SIZE * 5, CELL_SIZE * 42);
 
-    _UiManager.AddSlider(CELL_SIZE * 155, CELL_SIZE * 50, CELL_SIZE * 50, CELL_SIZE * 5, 1, 8, &selectionvalue);
+    _UiManager.AddSlider(SidebarX + CELL_SIZE * 5, CELL_SIZE * 50, CELL_SIZE * 50, CELL_SIZE * 5, 1, 8, &selectionvalue);
+
+    //Material counts, the materials the brush can place
+    _UiManager.AddText("Particles", SidebarX + CELL_SIZE * 5, CELL_SIZE * 60);
+
+    int CountLine = 0;
+
+    for (int material = 0; material < NUM_MATERIALS; material++) {
+        CellState state = static_cast<CellState>(material);
+        if (state == CellState::EMPTY || state == CellState::BEDROCK) continue;
+
+        _UiManager.AddText([state]() {
+            return CellStateToString(state) + ": " + std::to_string(MaterialCounts[static_cast<int>(state)]);
+            }, SidebarX + CELL_SIZE * 5, CELL_SIZE * (66 + CountLine * 6));
+
+        CountLine++;
+    }
+
+    //Frame profiler
+    int ProfilerY = 66 + CountLine * 6 + 2;
+
+    _UiManager.AddText("Frame Times (ms)", SidebarX + CELL_SIZE * 5, CELL_SIZE * ProfilerY);
+    _UiManager.AddText("p50 p95 p99 max, F2 saves", SidebarX + CELL_SIZE * 5, CELL_SIZE * (ProfilerY + 6));
+
+    for (int phase = 0; phase < NUM_FRAME_PHASES; phase++) {
+        _UiManager.AddText([phase]() {
+            return ProfileLines[phase];
+            }, SidebarX + CELL_SIZE * 5, CELL_SIZE * (ProfilerY + 13 + phase * 6));
+    }
 }
 
 #pragma endregion
 
 int main(int argc, char* argv[]) {
     SDL_SetMainReady();
+    SAND_TRACE_THREAD("Main");
+
+    //Optional grid size, thread count and seed: SandMaker <length> <width> <threads> <seed>,
+    //plus --record <file> / --replay <file> / --world <dir> anywhere
+    std::vector<std::string> args;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+
+        if (arg == "--record" && i + 1 < argc) RecordPath = argv[++i];
+        else if (arg == "--replay" && i + 1 < argc) ReplayPath = argv[++i];
+        else if (arg == "--world" && i + 1 < argc) WorldPath = argv[++i];
+        else args.push_back(arg);
+    }
+
+    if (args.size() >= 2) {
+        GridLength = std::max(3, std::atoi(args[0].c_str()));
+        GridWidth = std::max(3, std::atoi(args[1].c_str()));
+    }
+
+    if (args.size() >= 3) {
+        UpdateThreads = std::max(1, std::atoi(args[2].c_str()));
+    }
+
+    if (args.size() >= 4) {
+        SimSeed = std::strtoull(args[3].c_str(), nullptr, 10);
+    }
+
+    //A recording brings its own size and seed
+    Recording Session;
+
+    if (!ReplayPath.empty()) {
+        std::string error;
+
+        if (!LoadRecording(ReplayPath, Session, error)) {
+            std::cout << "Replay failed: " << error << "\n";
+            return 1;
+        }
+
+        GridLength = Session.length;
+        GridWidth = Session.width;
+        SimSeed = Session.seed;
+
+        std::cout << "Replaying " << ReplayPath << " (" << Session.endTick << " ticks)\n";
+    }
+
+    std::cout << "Seed: " << SimSeed << "\n";
+
+    SidebarX = CELL_SIZE * GridWidth;
 
     //Initialize Grid
-    Cell Grid[GRID_LENGTH][GRID_WIDTH] = {CellState::EMPTY};
+    CellGrid Grid(GridLength, GridWidth);
+
+    InitializeSim(Grid, SimSeed);
+    InitializeColors();
+
+    if (!WorldPath.empty()) {
+        std::string error;
+
+        if (!OpenWorld(Grid, WorldPath, error)) {
+            std::cout << "World failed: " << error << "\n";
+            return 1;
+        }
 
-    InitializeSim(Grid);
+        std::cout << "World: " << WorldPath << ", arrow keys move the window\n";
+    }
+
+    SetUpdateThreads(UpdateThreads);
 
 #pragma region Initialize Window
 
@@ -199,7 +350,7 @@ int main(int argc, char* argv[]) {
 
     window = SDL_CreateWindow("Sand Maker V1",
         SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
-        WINDOW_WIDTH, WINDOW_HEIGHT,
+        HORIZONTAL_PADDING + (CELL_SIZE * GridWidth), VERTICAL_PADDING + (CELL_SIZE * GridLength),
         SDL_WINDOW_SHOWN);
 
     SDL_Renderer* renderer = nullptr;
@@ -229,62 +380,114 @@ int main(int argc, char* argv[]) {
 
 #pragma endregion
 
+    RefreshProfileLines();
     SetUpUI();
 
+    //The sim ticks on its own thread from here on, the loop below only reads its snapshots
+    SimulationThread Sim(Grid);
+
+    if (!ReplayPath.empty()) {
+        Sim.Replay(&Session);
+    }
+
+    else if (!RecordPath.empty()) {
+        Session.length = GridLength;
+        Session.width = GridWidth;
+        Session.seed = SimSeed;
+        Sim.Record(&Session);
+    }
+
+    Sim.Start();
+
     // Infinite loop for application
     bool gameIsRunning = true;
 
     while (gameIsRunning) {
-        now = SDL_GetPerformanceCounter();
-        float deltaTime = (float)(now - last) / SDL_GetPerformanceFrequency();
-        last = now;
-
-        accumulator += deltaTime;
-
         frameStart = SDL_GetTicks();
-        frameCount++;
 
         Uint32 currentTime = SDL_GetTicks();
         if (currentTime - fpsLastTime >= 1000) {
-            fps = frameCount; // frames per last second
+            fps = frameCount; // frames presented in the last second (idle iterations that skip the draw don't count)
             frameCount = 0;
             fpsLastTime = currentTime;
-        }
 
-        SDL_Event event;
-        while (SDL_PollEvent(&event)) {
-            // Handle each specific event
-            if (event.type == SDL_QUIT) {
-                gameIsRunning = false; //Stop game
-            }
+            RefreshProfileLines();
+        }
 
-            //Logic to spawn particles on button hold
-            if (event.button.button == SDL_BUTTON_LEFT) {
-                if (event.type == SDL_MOUSEBUTTONDOWN) {
-                    LmbHeld = true;
+        {
+            ScopedPhase framePhase(GetProfiler(), FramePhase::FRAME);
+            SAND_TRACE_SCOPE("Frame");
+
+            {
+                ScopedPhase phase(GetProfiler(), FramePhase::EVENTS);
+
+                SDL_Event event;
+                while (SDL_PollEvent(&event)) {
+                    // Handle each specific event
+                    if (event.type == SDL_QUIT) {
+                        gameIsRunning = false; //Stop game
+                    }
+
+                    //Logic to spawn particles on button hold
+                    if (event.button.button == SDL_BUTTON_LEFT) {
+                        if (event.type == SDL_MOUSEBUTTONDOWN) {
+                            LmbHeld = true;
+                        }
+
+                        if (event.type == SDL_MOUSEBUTTONUP) {
+                            LmbHeld = false;
+                        }
+                    }
+
+                    if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F2) {
+                        DumpProfile();
+                    }
+
+                    if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F3) {
+                        DumpTrace();
+                    }
+
+                    HandleSimulationEvents(event, Sim);
+                    _UiManager.HandleUiEvents(event);
                 }
 
-                if (event.type == SDL_MOUSEBUTTONUP) {
-                    LmbHeld = false;
-                }
+                Sim.SetBrush(GetMouseBrush(LmbHeld, selectionvalue));
             }
 
-            HandleSimulationEvents(event, Grid);
-            _UiManager.HandleUiEvents(event);
-        }
+            //Nothing moved and the UI is unchanged, the last frame is still on screen
+            bool GridChanged = false;
 
-        while (accumulator >= FIXED_TIMESTEP) {
-            UpdateGrid(Grid, LmbHeld);
-            accumulator -= FIXED_TIMESTEP;
-        }
+            {
+                ScopedPhase phase(GetProfiler(), FramePhase::UPLOAD);
 
-        SetBrushSize(selectionvalue);
+                const GridSnapshot* Snapshot = Sim.AcquireSnapshot();
+                GridChanged = Snapshot && UpdateGridTexture(renderer, *Snapshot);
 
-        RenderGrid(renderer, Grid);
+                if (Snapshot) {
+                    std::copy(Snapshot->materialCounts, Snapshot->materialCounts + NUM_MATERIALS, MaterialCounts);
+                }
+            }
+
+            if (GridChanged || _UiManager.NeedsRedraw()) {
+                {
+                    ScopedPhase phase(GetProfiler(), FramePhase::DRAW);
+                    DrawGrid(renderer);
+                }
+
+                {
+                    ScopedPhase phase(GetProfiler(), FramePhase::UI);
+                    _UiManager.Render();
+                }
 
-        _UiManager.Render();
+                {
+                    ScopedPhase phase(GetProfiler(), FramePhase::PRESENT);
+                    SAND_TRACE_SCOPE("Present");
+                    SDL_RenderPresent(renderer);
+                }
 
-        SDL_RenderPresent(renderer);
+                frameCount++;
+            }
+        }
 
         frameTime = SDL_GetTicks() - frameStart;
         if (frameTime < FRAME_DELAY) {
@@ -293,6 +496,25 @@ int main(int argc, char* argv[]) {
 
     }
 
+    Sim.Stop();
+
+    if (WorldOpen()) {
+        std::string error;
+
+        if (!FlushWorld(Grid, error)) std::cout << "World save failed: " << error << "\n";
+    }
+
+    if (!RecordPath.empty() && ReplayPath.empty()) {
+        std::string error;
+
+        Session.endTick = Sim.TicksRun();
+        Session.checksum = GridChecksum(Grid);
+
+        if (SaveRecording(RecordPath, Session, error)) std::cout << "Recorded " << Session.endTick << " ticks to " << RecordPath << "\n";
+        else std::cout << "Recording failed: " << error << "\n";
+    }
+
+    ReleaseGridTexture();
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
 
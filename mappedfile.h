@@ -0,0 +1,31 @@
+#pragma once
+// C++ Standard Libraries
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+//Read only memory mapped file. The OS pages the file in as it's read, so opening even a big
+//file is just a couple of system calls. mmap on POSIX, a file mapping on Windows.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool Open(const std::string& path); //False if the file can't be opened/mapped or is empty
+    void Close();
+
+    const uint8_t* Data() const { return data; }
+    size_t Size() const { return size; }
+
+private:
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+
+#ifdef _WIN32
+    void* file = nullptr; //HANDLE
+    void* mapping = nullptr; //HANDLE
+#endif
+};
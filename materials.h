@@ -0,0 +1,146 @@
+#pragma once
+// C++ Standard Libraries
+#include <cstdint>
+
+#include "grid.h"
+
+//Material traits, fixed at compile time. Indexed by CellState, so per material lookups are a
+//single load from a constant table and calls with a known state fold down to a constant.
+
+//How a material moves when it updates
+enum class MoveClass : uint8_t {
+    STATIC, //Never moves on its own (rock, bedrock, empty)
+    POWDER, //Falls straight down or diagonally
+    LIQUID //Falls, then spreads sideways
+};
+
+//Trait flags, one bitmask per material
+enum MaterialFlag : uint8_t {
+    MAT_LIQUID = 1 << 0, //Is particle a liquid? (if not, then solid)
+    MAT_SUBMERSIBLE = 1 << 1 //Sinks through lighter liquids, or does it just fall in air?
+};
+
+struct MaterialTraits {
+    CellState state; //Must match the table index
+    uint8_t flags;
+    MoveClass move;
+    int density; //Density of material
+    uint8_t reactionDelay; //Combo delays (frame delay), same width as the per cell timers
+    int fallSpeed; //Gravity for material, cells per tick added to the fall speed every tick it falls
+    int dispersion; //Cells a liquid can spread sideways in one tick
+};
+
+constexpr MaterialTraits Materials[NUM_MATERIALS] = {
+    //state               flags                           move               density  delay  fall  spread
+    { CellState::EMPTY,   0,                              MoveClass::STATIC,       0,     0,    0,      0 },
+    { CellState::SAND,    MAT_SUBMERSIBLE,                MoveClass::POWDER,       5,     5,    1,      0 },
+    { CellState::ROCK,    0,                              MoveClass::STATIC,      10,   150,    0,      0 },
+    { CellState::BEDROCK, 0,                              MoveClass::STATIC,     500,   255,    0,      0 },
+    { CellState::WATER,   MAT_LIQUID | MAT_SUBMERSIBLE,   MoveClass::LIQUID,       3,     5,    1,      5 },
+    { CellState::ACID,    MAT_LIQUID | MAT_SUBMERSIBLE,   MoveClass::LIQUID,       4,     5,    1,      3 },
+};
+
+constexpr bool MaterialTableInOrder(int i = 0) {
+    return i == NUM_MATERIALS || (static_cast<int>(Materials[i].state) == i && MaterialTableInOrder(i + 1));
+}
+
+static_assert(MaterialTableInOrder(), "Materials must be listed in CellState order");
+
+constexpr const MaterialTraits& GetMaterial(CellState state) { return Materials[static_cast<int>(state)]; }
+
+//Furthest a particle can move in one update: a full speed fall, or the widest spread
+constexpr int MaxReach(int i = 0) {
+    return i == NUM_MATERIALS ? MAX_VELOCITY :
+        (Materials[i].dispersion > MaxReach(i + 1) ? Materials[i].dispersion : MaxReach(i + 1));
+}
+
+constexpr int MAX_REACH = MaxReach();
+
+constexpr bool IsLiquid(CellState state) { return (GetMaterial(state).flags & MAT_LIQUID) != 0; }
+constexpr uint8_t ReactionDelay(CellState state) { return GetMaterial(state).reactionDelay; }
+
+//Bit per material the row's material sinks through: submersible, the other is a liquid and lighter
+struct SinkTable {
+    uint32_t mask[NUM_MATERIALS];
+};
+
+constexpr SinkTable BuildSinkTable() {
+    SinkTable table{};
+
+    for (int curr = 0; curr < NUM_MATERIALS; curr++) {
+        for (int other = 0; other < NUM_MATERIALS; other++) {
+            if ((Materials[curr].flags & MAT_SUBMERSIBLE) && (Materials[other].flags & MAT_LIQUID) &&
+                Materials[curr].density > Materials[other].density) {
+                table.mask[curr] |= 1u << other;
+            }
+        }
+    }
+
+    return table;
+}
+
+constexpr SinkTable SinkMasks = BuildSinkTable();
+
+static_assert(NUM_MATERIALS <= 32, "Sink masks hold one bit per material");
+
+//Can a particle of curr swap down into other
+inline bool SinksInto(CellState curr, CellState other) {
+    return (SinkMasks.mask[static_cast<int>(curr)] >> static_cast<int>(other)) & 1u;
+}
+
+//What a cell turns into when it reacts with a neighbor. Each reaction rolls on its own: chance
+//percent of the time the cell becomes outcome, otherwise alternate.
+struct Reaction {
+    bool reacts;
+    CellState outcome;
+    CellState alternate;
+    uint8_t chance; //Percent, 0-100
+};
+
+struct ReactionRule {
+    CellState cell;
+    CellState neighbor;
+    Reaction reaction;
+};
+
+//Pairs not listed here don't react
+constexpr ReactionRule ReactionRules[] = {
+    //cell               neighbor                   outcome           alternate          chance
+    { CellState::SAND,   CellState::ACID,   { true, CellState::ACID,  CellState::EMPTY,  50 } },
+    { CellState::ROCK,   CellState::ACID,   { true, CellState::ACID,  CellState::EMPTY,  50 } },
+    { CellState::WATER,  CellState::ACID,   { true, CellState::ACID,  CellState::EMPTY,  50 } },
+};
+
+struct ReactionTable {
+    Reaction entry[NUM_MATERIALS][NUM_MATERIALS]; //[cell][neighbor]
+};
+
+constexpr ReactionTable BuildReactionTable() {
+    ReactionTable table{};
+
+    for (int cell = 0; cell < NUM_MATERIALS; cell++) {
+        for (int neighbor = 0; neighbor < NUM_MATERIALS; neighbor++) {
+            table.entry[cell][neighbor] = { false, static_cast<CellState>(cell), static_cast<CellState>(cell), 0 };
+        }
+    }
+
+    for (const ReactionRule& rule : ReactionRules) {
+        table.entry[static_cast<int>(rule.cell)][static_cast<int>(rule.neighbor)] = rule.reaction;
+    }
+
+    return table;
+}
+
+constexpr ReactionTable Reactions = BuildReactionTable();
+
+constexpr bool ReactionRulesValid(int i = 0) {
+    return i == static_cast<int>(sizeof(ReactionRules) / sizeof(ReactionRules[0])) ||
+        (ReactionRules[i].cell != ReactionRules[i].neighbor && ReactionRules[i].cell != CellState::EMPTY &&
+            ReactionRules[i].neighbor != CellState::EMPTY && ReactionRules[i].reaction.chance <= 100 && ReactionRulesValid(i + 1));
+}
+
+static_assert(ReactionRulesValid(), "Reactions are between two different, non empty materials, with a chance of at most 100");
+
+constexpr const Reaction& GetReaction(CellState cell, CellState neighbor) {
+    return Reactions.entry[static_cast<int>(cell)][static_cast<int>(neighbor)];
+}
@@ -0,0 +1,136 @@
+#include "profiler.h"
+
+// C++ Standard Libraries
+#include <algorithm>
+#include <fstream>
+
+#pragma region Phases
+
+const char* FramePhaseName(FramePhase phase) {
+    switch (phase) {
+    case FramePhase::EVENTS: return "Events";
+    case FramePhase::UPDATE: return "Update";
+    case FramePhase::UPLOAD: return "Upload";
+    case FramePhase::DRAW: return "Draw";
+    case FramePhase::UI: return "Ui";
+    case FramePhase::PRESENT: return "Present";
+    case FramePhase::FRAME: return "Frame";
+    default: return "Unknown";
+    }
+}
+
+FrameProfiler& GetProfiler() {
+    static FrameProfiler profiler;
+    return profiler;
+}
+
+#pragma endregion
+
+#pragma region Profiler
+
+FrameProfiler::FrameProfiler() {
+    for (Ring& ring : rings) {
+        ring.samples.assign(PROFILER_WINDOW, 0.0);
+    }
+}
+
+void FrameProfiler::Add(FramePhase phase, double ms) {
+    std::lock_guard<std::mutex> guard(lock);
+
+    Ring& ring = rings[static_cast<int>(phase)];
+    ring.samples[ring.next] = ms;
+    ring.next = (ring.next + 1) % ring.samples.size();
+    ring.count = std::min(ring.count + 1, ring.samples.size());
+}
+
+std::vector<double> FrameProfiler::RecentSamples(int phase) const {
+    const Ring& ring = rings[phase];
+    std::vector<double> recent;
+    recent.reserve(ring.count);
+
+    size_t first = (ring.next + ring.samples.size() - ring.count) % ring.samples.size();
+
+    for (size_t i = 0; i < ring.count; i++) {
+        recent.push_back(ring.samples[(first + i) % ring.samples.size()]);
+    }
+
+    return recent;
+}
+
+PhaseStats FrameProfiler::Stats(FramePhase phase) const {
+    std::vector<double> sorted;
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        sorted = RecentSamples(static_cast<int>(phase));
+    }
+
+    PhaseStats stats;
+    stats.samples = static_cast<int>(sorted.size());
+    if (sorted.empty()) return stats;
+
+    std::sort(sorted.begin(), sorted.end());
+
+    //Nearest rank
+    auto Percentile = [&sorted](double p) {
+        size_t rank = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+        return sorted[rank];
+    };
+
+    stats.p50 = Percentile(0.50);
+    stats.p95 = Percentile(0.95);
+    stats.p99 = Percentile(0.99);
+    stats.max = sorted.back();
+
+    return stats;
+}
+
+bool FrameProfiler::DumpCsv(const std::string& path, std::string& error) const {
+    std::vector<double> columns[NUM_FRAME_PHASES];
+    size_t rows = 0;
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        for (int phase = 0; phase < NUM_FRAME_PHASES; phase++) {
+            columns[phase] = RecentSamples(phase);
+            rows = std::max(rows, columns[phase].size());
+        }
+    }
+
+    std::ofstream file(path);
+
+    if (!file) {
+        error = "can't open " + path + " for writing";
+        return false;
+    }
+
+    file << "sample";
+    for (int phase = 0; phase < NUM_FRAME_PHASES; phase++) {
+        file << "," << FramePhaseName(static_cast<FramePhase>(phase)) << "_ms";
+    }
+    file << "\n";
+
+    //Phases that ran less often (skipped draws) are short, line everything up on the newest sample
+    for (size_t row = 0; row < rows; row++) {
+        file << row;
+
+        for (const std::vector<double>& column : columns) {
+            file << ",";
+
+            size_t missing = rows - column.size();
+            if (row >= missing) file << column[row - missing];
+        }
+
+        file << "\n";
+    }
+
+    if (!file) {
+        error = "write to " + path + " failed";
+        return false;
+    }
+
+    return true;
+}
+
+#pragma endregion
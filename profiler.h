@@ -0,0 +1,79 @@
+#pragma once
+// C++ Standard Libraries
+#include <string>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+
+//Frame time profiler: scoped timers around each phase of the main loop (and the sim tick on
+//its own thread) feed a rolling window of samples per phase, which gives percentiles that
+//show spikes an FPS counter averages away.
+
+enum class FramePhase : uint8_t {
+    EVENTS, //SDL_PollEvent and input handling
+    UPDATE, //One UpdateGrid tick (sim thread)
+    UPLOAD, //Snapshot to grid texture
+    DRAW, //Grid texture to the renderer
+    UI, //_UiManager.Render
+    PRESENT, //SDL_RenderPresent
+    FRAME, //Whole frame, without the frame cap delay
+    COUNT
+};
+
+const int NUM_FRAME_PHASES = static_cast<int>(FramePhase::COUNT);
+const int PROFILER_WINDOW = 600; //Samples kept per phase, 10 seconds of frames
+
+const char* FramePhaseName(FramePhase phase);
+
+struct PhaseStats {
+    int samples = 0;
+    double p50 = 0;
+    double p95 = 0;
+    double p99 = 0;
+    double max = 0; //All in milliseconds
+};
+
+class FrameProfiler {
+public:
+    FrameProfiler();
+
+    void Add(FramePhase phase, double ms); //Safe from any thread
+    PhaseStats Stats(FramePhase phase) const;
+
+    //One row per sample (newest last), one column per phase, in milliseconds
+    bool DumpCsv(const std::string& path, std::string& error) const;
+
+private:
+    std::vector<double> RecentSamples(int phase) const; //Oldest first, lock held by the caller
+
+    struct Ring {
+        std::vector<double> samples;
+        size_t next = 0;
+        size_t count = 0;
+    };
+
+    Ring rings[NUM_FRAME_PHASES];
+    mutable std::mutex lock;
+};
+
+//Main loop phases, and the sim thread's ticks
+FrameProfiler& GetProfiler();
+
+//Times its scope into a phase
+class ScopedPhase {
+public:
+    ScopedPhase(FrameProfiler& profiler, FramePhase phase) : profiler(profiler), phase(phase), start(std::chrono::steady_clock::now()) {}
+
+    ~ScopedPhase() {
+        profiler.Add(phase, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    ScopedPhase(const ScopedPhase&) = delete;
+    ScopedPhase& operator=(const ScopedPhase&) = delete;
+
+private:
+    FrameProfiler& profiler;
+    FramePhase phase;
+    std::chrono::steady_clock::time_point start;
+};
@@ -0,0 +1,206 @@
+#include "replay.h"
+
+// C++ Standard Libraries
+#include <fstream>
+#include <sstream>
+
+#include "simulation.h"
+
+#pragma region Helper Functions
+
+const char* const REPLAY_MAGIC = "sandmaker-replay";
+
+//Material by its name, false for names this build doesn't know
+bool MaterialFromName(const std::string& name, CellState& state) {
+    for (int material = 0; material < NUM_MATERIALS; material++) {
+        if (CellStateToString(static_cast<CellState>(material)) == name) {
+            state = static_cast<CellState>(material);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+#pragma endregion
+
+#pragma region Recording Files
+
+bool IsRecordedCommand(const SimCommand& command) {
+    return command.type != SimCommand::Type::SAVE;
+}
+
+bool SaveRecording(const std::string& path, const Recording& recording, std::string& error) {
+    std::ofstream file(path);
+
+    if (!file) {
+        error = "can't open " + path + " for writing";
+        return false;
+    }
+
+    file << REPLAY_MAGIC << " " << REPLAY_FILE_VERSION << "\n";
+    file << "grid " << recording.length << " " << recording.width << "\n";
+    file << "seed " << recording.seed << "\n";
+
+    for (const RecordedCommand& entry : recording.commands) {
+        const SimCommand& command = entry.command;
+
+        switch (command.type) {
+        case SimCommand::Type::BRUSH:
+            file << entry.tick << " brush " << command.brush.Active << " " << command.brush.y << " " << command.brush.x
+                << " " << command.brush.Size << " " << CellStateToString(command.brush.Material) << "\n";
+            break;
+
+        case SimCommand::Type::RESET:
+            file << entry.tick << " reset\n";
+            break;
+
+        case SimCommand::Type::LOAD:
+            file << entry.tick << " load " << command.path << "\n";
+            break;
+
+        case SimCommand::Type::PAN:
+            file << entry.tick << " pan " << command.dy << " " << command.dx << "\n";
+            break;
+
+        case SimCommand::Type::SAVE:
+            break;
+        }
+    }
+
+    file << "end " << recording.endTick << " " << std::hex << recording.checksum << std::dec << "\n";
+
+    if (!file) {
+        error = "write to " + path + " failed";
+        return false;
+    }
+
+    return true;
+}
+
+bool LoadRecording(const std::string& path, Recording& recording, std::string& error) {
+    std::ifstream file(path);
+
+    if (!file) {
+        error = "can't open " + path;
+        return false;
+    }
+
+    Recording loaded;
+    std::string line;
+    int lineNumber = 0;
+    bool ended = false;
+
+    while (std::getline(file, line)) {
+        lineNumber++;
+        if (line.empty()) continue;
+
+        std::istringstream fields(line);
+        std::string first;
+        fields >> first;
+
+        bool ok = true;
+
+        if (lineNumber == 1) {
+            int version = 0;
+            fields >> version;
+
+            if (first != REPLAY_MAGIC) {
+                error = path + " is not a recording";
+                return false;
+            }
+
+            if (version != REPLAY_FILE_VERSION) {
+                error = "unsupported recording version " + std::to_string(version);
+                return false;
+            }
+
+            continue;
+        }
+
+        if (first == "grid") ok = static_cast<bool>(fields >> loaded.length >> loaded.width) && loaded.length >= 3 && loaded.width >= 3;
+        else if (first == "seed") ok = static_cast<bool>(fields >> loaded.seed);
+        else if (first == "end") ok = ended = static_cast<bool>(fields >> loaded.endTick >> std::hex >> loaded.checksum);
+        else {
+            RecordedCommand entry;
+            std::string type;
+
+            std::istringstream tick(first);
+            ok = static_cast<bool>(tick >> entry.tick) && static_cast<bool>(fields >> type);
+
+            if (ok && type == "brush") {
+                BrushInput& brush = entry.command.brush;
+                std::string material;
+
+                entry.command.type = SimCommand::Type::BRUSH;
+                ok = static_cast<bool>(fields >> brush.Active >> brush.y >> brush.x >> brush.Size >> material) &&
+                    MaterialFromName(material, brush.Material);
+            }
+
+            else if (ok && type == "reset") {
+                entry.command.type = SimCommand::Type::RESET;
+            }
+
+            else if (ok && type == "load") {
+                entry.command.type = SimCommand::Type::LOAD;
+                std::getline(fields >> std::ws, entry.command.path);
+                ok = !entry.command.path.empty();
+            }
+
+            else if (ok && type == "pan") {
+                entry.command.type = SimCommand::Type::PAN;
+                ok = static_cast<bool>(fields >> entry.command.dy >> entry.command.dx);
+            }
+
+            else {
+                ok = false;
+            }
+
+            //Commands are applied in file order, so the stamps can only go up
+            if (ok && !loaded.commands.empty() && entry.tick < loaded.commands.back().tick) ok = false;
+
+            if (ok) loaded.commands.push_back(entry);
+        }
+
+        if (!ok) {
+            error = path + ":" + std::to_string(lineNumber) + ": bad entry \"" + line + "\"";
+            return false;
+        }
+    }
+
+    if (lineNumber == 0 || loaded.length == 0 || !ended) {
+        error = path + " is incomplete";
+        return false;
+    }
+
+    recording = loaded;
+    return true;
+}
+
+#pragma endregion
+
+#pragma region Replay
+
+uint64_t GridChecksum(const CellGrid& Grid) {
+    uint64_t hash = 14695981039346656037ULL;
+
+    for (int y = 0; y < Grid.Length(); y++) {
+        const CellWord* words = Grid.WordRow(y);
+
+        for (int x = 0; x < Grid.Width(); x++) {
+            hash = (hash ^ static_cast<uint8_t>(WordState(words[x]))) * 1099511628211ULL;
+            hash = (hash ^ WordWetness(words[x])) * 1099511628211ULL;
+        }
+    }
+
+    return hash;
+}
+
+void Replayer::Apply(uint64_t tick, CellGrid& Grid, BrushInput& Brush) {
+    while (next < recording.commands.size() && recording.commands[next].tick <= tick) {
+        ApplySimCommand(Grid, recording.commands[next].command, Brush);
+        next++;
+    }
+}
+
+#pragma endregion
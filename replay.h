@@ -0,0 +1,64 @@
+#pragma once
+// C++ Standard Libraries
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "grid.h"
+#include "simthread.h"
+
+//Recorded sessions: the seed and grid size a session started with, and every command that
+//changed the grid, stamped with the tick it was applied on. The sim is deterministic for a
+//seed, so feeding the commands back on the same ticks reproduces the session cell for cell.
+//
+//Text file, one entry per line:
+//  sandmaker-replay <version>
+//  grid <length> <width>
+//  seed <seed>
+//  <tick> brush <active> <y> <x> <size> <material name>
+//  <tick> reset
+//  <tick> load <path> (the world file has to be unchanged for the replay to match)
+//  <tick> pan <dy> <dx> (replay with the same sparse world directory, unchanged, to match)
+//  end <tick> <checksum>
+
+const int REPLAY_FILE_VERSION = 1;
+
+struct RecordedCommand {
+    uint64_t tick = 0; //Applied before this tick's update
+    SimCommand command;
+};
+
+struct Recording {
+    int length = 0;
+    int width = 0;
+    uint64_t seed = 0;
+
+    std::vector<RecordedCommand> commands; //In the order they were applied
+
+    uint64_t endTick = 0; //Ticks run when recording stopped
+    uint64_t checksum = 0; //GridChecksum at endTick
+};
+
+bool SaveRecording(const std::string& path, const Recording& recording, std::string& error);
+bool LoadRecording(const std::string& path, Recording& recording, std::string& error);
+
+//Does this command change the grid (and so belong in a recording)
+bool IsRecordedCommand(const SimCommand& command);
+
+//FNV-1a over the state and wetness of every cell, for checking two runs ended up the same
+uint64_t GridChecksum(const CellGrid& Grid);
+
+//Feeds a recording back one tick at a time
+class Replayer {
+public:
+    explicit Replayer(const Recording& recording) : recording(recording) {}
+
+    //Apply the commands stamped with tick, call once per tick in order before UpdateGrid
+    void Apply(uint64_t tick, CellGrid& Grid, BrushInput& Brush);
+
+    bool Finished(uint64_t tick) const { return tick >= recording.endTick; }
+
+private:
+    const Recording& recording;
+    size_t next = 0;
+};
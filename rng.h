@@ -0,0 +1,43 @@
+#pragma once
+// C++ Standard Libraries
+#include <cstdint>
+
+//PCG32 generator (pcg-random.org). Small enough to keep one per chunk, so chunks updated on
+//different threads never share state and a run is reproducible from its seed alone.
+class Rng {
+public:
+    Rng() { Seed(0, 0); }
+    Rng(uint64_t seed, uint64_t stream) { Seed(seed, stream); }
+
+    //Streams with the same seed give independent sequences
+    void Seed(uint64_t seed, uint64_t stream) {
+        state = 0;
+        increment = (stream << 1) | 1;
+        Next();
+        state += seed;
+        Next();
+    }
+
+    uint32_t Next() {
+        uint64_t old = state;
+        state = old * 6364136223846793005ULL + increment;
+
+        uint32_t xorShifted = static_cast<uint32_t>(((old >> 18) ^ old) >> 27);
+        uint32_t rot = static_cast<uint32_t>(old >> 59);
+
+        return (xorShifted >> rot) | (xorShifted << ((32 - rot) & 31));
+    }
+
+    //Uniform in [0, bound). Multiply and shift instead of %, no division or branch.
+    uint32_t Below(uint32_t bound) {
+        return static_cast<uint32_t>((static_cast<uint64_t>(Next()) * bound) >> 32);
+    }
+
+    bool OneIn(uint32_t n) { return Below(n) == 0; }
+
+    bool CoinFlip() { return (Next() >> 31) != 0; }
+
+    //Raw state, for saving and restoring a generator
+    uint64_t state = 0;
+    uint64_t increment = 1;
+};
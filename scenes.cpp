@@ -0,0 +1,111 @@
+#include "scenes.h"
+
+// C++ Standard Libraries
+#include <algorithm>
+
+#include "simulation.h"
+
+#pragma region Helper Functions
+
+//Fill an inclusive rect of the interior (the bedrock border is left alone)
+void FillRect(CellGrid& Grid, CellState state, int minY, int minX, int maxY, int maxX) {
+    minY = std::max(minY, 1);
+    minX = std::max(minX, 1);
+    maxY = std::min(maxY, Grid.Length() - 2);
+    maxX = std::min(maxX, Grid.Width() - 2);
+
+    for (int y = minY; y <= maxY; y++) {
+        for (int x = minX; x <= maxX; x++) {
+            Grid.Set(y, x, Cell{ state });
+        }
+    }
+}
+
+#pragma endregion
+
+#pragma region Scenes
+
+//Column of sand in the middle third, falling into an empty world
+void SandColumnScene(CellGrid& Grid) {
+    int L = Grid.Length(), W = Grid.Width();
+    FillRect(Grid, CellState::SAND, 1, W / 3, L / 2, W * 2 / 3);
+}
+
+//Bottom three quarters full of water
+void WaterTankScene(CellGrid& Grid) {
+    int L = Grid.Length(), W = Grid.Width();
+    FillRect(Grid, CellState::WATER, L / 4, 1, L - 2, W - 2);
+}
+
+//Sand resting on top of a pool, sinking through it
+void SandIntoWaterScene(CellGrid& Grid) {
+    int L = Grid.Length(), W = Grid.Width();
+    FillRect(Grid, CellState::WATER, L / 2, 1, L - 2, W - 2);
+    FillRect(Grid, CellState::SAND, L / 4, 1, L / 2 - 1, W - 2);
+}
+
+//Layer of acid sitting on a rock floor
+void AcidOnRockScene(CellGrid& Grid) {
+    int L = Grid.Length(), W = Grid.Width();
+    FillRect(Grid, CellState::ROCK, L / 2, 1, L - 2, W - 2);
+    FillRect(Grid, CellState::ACID, L / 3, 1, L / 2 - 1, W - 2);
+}
+
+//Flat dry layers that have nowhere to go, goes to sleep after the first tick
+void SettledScene(CellGrid& Grid) {
+    int L = Grid.Length(), W = Grid.Width();
+    FillRect(Grid, CellState::ROCK, L * 3 / 4, 1, L - 2, W - 2);
+    FillRect(Grid, CellState::SAND, L / 2, 1, L * 3 / 4 - 1, W - 2);
+}
+
+//Sand piled in the bottom left corner. With a sparse world open there's no border, so it spills
+//onto the window's edge cells (run with --check-dirty to see those get redrawn).
+void SandOnEdgeScene(CellGrid& Grid) {
+    int L = Grid.Length(), W = Grid.Width();
+    FillRect(Grid, CellState::SAND, L / 2, 1, L - 2, W / 4);
+}
+
+#pragma endregion
+
+#pragma region Scene Lookup
+
+struct Scene {
+    const char* name;
+    void (*build)(CellGrid&); //nullptr = leave the world empty
+};
+
+const Scene Scenes[] = {
+    { "empty", nullptr },
+    { "sand-column", SandColumnScene },
+    { "water-tank", WaterTankScene },
+    { "sand-into-water", SandIntoWaterScene },
+    { "acid-on-rock", AcidOnRockScene },
+    { "settled", SettledScene },
+    { "sand-on-edge", SandOnEdgeScene },
+};
+
+bool BuildScene(CellGrid& Grid, const std::string& name) {
+    for (const Scene& scene : Scenes) {
+        if (name != scene.name) continue;
+
+        ResetGrid(Grid);
+        if (scene.build) scene.build(Grid);
+
+        Grid.WakeAll();
+        return true;
+    }
+
+    return false;
+}
+
+std::vector<std::string> GetSceneNames() {
+    std::vector<std::string> names;
+
+    for (const Scene& scene : Scenes) {
+        names.push_back(scene.name);
+    }
+
+    return names;
+}
+
+#pragma endregion
@@ -0,0 +1,14 @@
+#pragma once
+// C++ Standard Libraries
+#include <string>
+#include <vector>
+
+#include "grid.h"
+
+//Fixed starting worlds for the headless runner and benchmarks. Every scene scales to the grid
+//size, and starts from ResetGrid so it doesn't depend on what was in the grid before.
+
+//Build the named scene into the grid, false if there's no scene with that name
+bool BuildScene(CellGrid& Grid, const std::string& name);
+
+std::vector<std::string> GetSceneNames();
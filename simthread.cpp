@@ -0,0 +1,259 @@
+#include "simthread.h"
+
+// C++ Standard Libraries
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+
+#include "worldfile.h"
+#include "world.h"
+#include "replay.h"
+#include "profiler.h"
+#include "trace.h"
+
+#pragma region Thread Control
+
+SimulationThread::SimulationThread(CellGrid& Grid_) : Grid(Grid_) {
+    size_t count = static_cast<size_t>(Grid.Length()) * Grid.Width();
+
+    for (int i = 0; i < 3; i++) {
+        snapshots[i].length = Grid.Length();
+        snapshots[i].width = Grid.Width();
+        snapshots[i].words.assign(count, 0);
+
+        stale[i].Include(0, 0, Grid.Width() - 1, Grid.Length() - 1); //Nothing copied yet
+    }
+}
+
+SimulationThread::~SimulationThread() {
+    Stop();
+}
+
+void SimulationThread::Record(Recording* recording) {
+    recorder = recording;
+}
+
+void SimulationThread::Replay(const Recording* recording) {
+    replaying = recording;
+    replayer.reset(recording ? new Replayer(*recording) : nullptr);
+}
+
+void SimulationThread::Start() {
+    if (running) return;
+
+    running = true;
+    thread = std::thread(&SimulationThread::Run, this);
+}
+
+void SimulationThread::Stop() {
+    running = false;
+
+    if (thread.joinable()) thread.join();
+}
+
+void SimulationThread::Run() {
+    SAND_TRACE_THREAD("Sim");
+
+    using Clock = std::chrono::steady_clock;
+
+    const Clock::duration Step = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(FIXED_TIMESTEP));
+    Clock::time_point next = Clock::now();
+
+    Publish(); //Something to draw before the first tick
+
+    while (running) {
+        ApplyCommands();
+
+        {
+            ScopedPhase phase(GetProfiler(), FramePhase::UPDATE);
+            UpdateGrid(Grid, brush);
+        }
+
+        ticksRun.fetch_add(1, std::memory_order_relaxed);
+
+        Publish();
+
+        next += Step;
+
+        //Too far behind to catch up, carry on from now instead of running a burst of ticks
+        Clock::time_point now = Clock::now();
+        if (now - next > Step * MAX_CATCHUP_TICKS) next = now;
+
+        std::this_thread::sleep_until(next);
+    }
+}
+
+#pragma endregion
+
+#pragma region Input
+
+void SimulationThread::Post(const SimCommand& command) {
+    std::lock_guard<std::mutex> lock(commandLock);
+    commands.push_back(command);
+}
+
+void SimulationThread::SetBrush(const BrushInput& newBrush) {
+    if (newBrush == postedBrush) return;
+
+    postedBrush = newBrush;
+
+    SimCommand command;
+    command.type = SimCommand::Type::BRUSH;
+    command.brush = newBrush;
+    Post(command);
+}
+
+void SimulationThread::Reset() {
+    SimCommand command;
+    command.type = SimCommand::Type::RESET;
+    Post(command);
+}
+
+void SimulationThread::Save(const std::string& path) {
+    SimCommand command;
+    command.type = SimCommand::Type::SAVE;
+    command.path = path;
+    Post(command);
+}
+
+void SimulationThread::Load(const std::string& path) {
+    SimCommand command;
+    command.type = SimCommand::Type::LOAD;
+    command.path = path;
+    Post(command);
+}
+
+void SimulationThread::Pan(int dy, int dx) {
+    SimCommand command;
+    command.type = SimCommand::Type::PAN;
+    command.dy = dy;
+    command.dx = dx;
+    Post(command);
+}
+
+void ApplySimCommand(CellGrid& Grid, const SimCommand& command, BrushInput& Brush) {
+    switch (command.type) {
+    case SimCommand::Type::BRUSH:
+        Brush = command.brush;
+        break;
+
+    case SimCommand::Type::RESET:
+        ResetGrid(Grid);
+        break;
+
+    case SimCommand::Type::SAVE:
+    case SimCommand::Type::LOAD: {
+        std::string error;
+        bool saving = command.type == SimCommand::Type::SAVE;
+        bool done = saving ? SaveWorld(command.path, Grid, error) : LoadWorld(command.path, Grid, error);
+
+        if (done) std::cout << (saving ? "Saved " : "Loaded ") << command.path << "\n";
+        else std::cout << (saving ? "Save failed: " : "Load failed: ") << error << "\n";
+        break;
+    }
+
+    case SimCommand::Type::PAN:
+        PanWorld(Grid, command.dy, command.dx);
+        break;
+    }
+}
+
+void SimulationThread::ApplyCommands() {
+    {
+        std::lock_guard<std::mutex> lock(commandLock);
+        applying.swap(commands);
+    }
+
+    uint64_t tick = ticksRun.load(std::memory_order_relaxed);
+
+    if (replayer) {
+        replayer->Apply(tick, Grid, brush);
+
+        if (replayer->Finished(tick)) {
+            bool match = GridChecksum(Grid) == replaying->checksum;
+            std::cout << "Replay finished at tick " << tick << (match ? ", grid matches the recording\n" : ", grid differs from the recording\n");
+
+            replayer.reset();
+            replaying = nullptr;
+        }
+    }
+
+    //Live input is ignored while replaying, apart from saving
+    if (replayer) {
+        applying.erase(std::remove_if(applying.begin(), applying.end(), [](const SimCommand& command) {
+            return command.type != SimCommand::Type::SAVE;
+            }), applying.end());
+    }
+
+    for (const SimCommand& command : applying) {
+        if (recorder && IsRecordedCommand(command)) recorder->commands.push_back({ tick, command });
+
+        ApplySimCommand(Grid, command, brush);
+    }
+
+    applying.clear();
+}
+
+#pragma endregion
+
+#pragma region Snapshots
+
+void SimulationThread::Publish() {
+    SAND_TRACE_SCOPE("Publish");
+
+    DirtyRect changed = Grid.TakeRenderDirty();
+
+    if (!changed.Empty()) {
+        for (DirtyRect& rect : stale) {
+            rect.Include(changed.minX, changed.minY, changed.maxX, changed.maxY);
+        }
+    }
+
+    //Bring the back buffer up to date, only the parts that changed since it was last written
+    GridSnapshot& snapshot = snapshots[back];
+    DirtyRect& behind = stale[back];
+
+    if (!behind.Empty()) {
+        size_t span = static_cast<size_t>(behind.maxX - behind.minX + 1);
+
+        for (int y = behind.minY; y <= behind.maxY; y++) {
+            size_t offset = static_cast<size_t>(y) * snapshot.width + behind.minX;
+
+            std::memcpy(snapshot.words.data() + offset, Grid.WordRow(y) + behind.minX, span * sizeof(CellWord));
+        }
+
+        behind = DirtyRect();
+    }
+
+    snapshot.tick = ticksRun.load(std::memory_order_relaxed);
+
+    for (int material = 0; material < NUM_MATERIALS; material++) {
+        snapshot.materialCounts[material] = Grid.MaterialCount(static_cast<CellState>(material));
+    }
+    snapshot.dirty = changed;
+
+    std::lock_guard<std::mutex> lock(swapLock);
+
+    //The reader never saw the snapshot being replaced, carry its changes over
+    if (readyFresh && !snapshots[ready].dirty.Empty()) {
+        const DirtyRect& skipped = snapshots[ready].dirty;
+        snapshot.dirty.Include(skipped.minX, skipped.minY, skipped.maxX, skipped.maxY);
+    }
+
+    std::swap(back, ready);
+    readyFresh = true;
+}
+
+const GridSnapshot* SimulationThread::AcquireSnapshot() {
+    std::lock_guard<std::mutex> lock(swapLock);
+
+    if (!readyFresh) return nullptr;
+
+    std::swap(front, ready);
+    readyFresh = false;
+
+    return &snapshots[front];
+}
+
+#pragma endregion
@@ -0,0 +1,117 @@
+#pragma once
+// C++ Standard Libraries
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <memory>
+
+#include "constants.h"
+#include "grid.h"
+#include "simulation.h"
+
+//Copy of the cell words (state, wetness) of a finished tick. Rows are packed (stride = width).
+struct GridSnapshot {
+    int length = 0;
+    int width = 0;
+    uint64_t tick = 0; //Ticks run when this was taken
+
+    std::vector<CellWord> words;
+
+    DirtyRect dirty; //Cells that changed since the previous snapshot the reader took
+
+    int64_t materialCounts[NUM_MATERIALS] = {}; //CellGrid::MaterialCount when this was taken
+
+    int Length() const { return length; }
+    int Width() const { return width; }
+
+    const CellWord* WordRow(int y) const { return words.data() + static_cast<size_t>(y) * width; }
+};
+
+//Input for the sim, applied at the start of the next tick
+struct SimCommand {
+    enum class Type : uint8_t {
+        BRUSH, //Replace the brush
+        RESET, //Empty the world
+        SAVE, //Save the world to path
+        LOAD, //Load the world in path
+        PAN //Move the sparse world window by (dy, dx) chunks
+    };
+
+    Type type = Type::BRUSH;
+    BrushInput brush;
+    std::string path;
+    int dy = 0;
+    int dx = 0;
+};
+
+//Apply a command to the grid, BRUSH replaces the brush the next UpdateGrid spawns with
+void ApplySimCommand(CellGrid& Grid, const SimCommand& command, BrushInput& Brush);
+
+struct Recording;
+class Replayer;
+
+//Runs UpdateGrid at the fixed timestep on its own thread, so a slow frame doesn't hold back the
+//sim and a slow tick doesn't drop frames. Every tick is published into a triple buffered
+//snapshot, the render thread draws the newest one and never touches the live grid.
+class SimulationThread {
+public:
+    explicit SimulationThread(CellGrid& Grid);
+    ~SimulationThread();
+
+    SimulationThread(const SimulationThread&) = delete;
+    SimulationThread& operator=(const SimulationThread&) = delete;
+
+    //Set before Start. Record appends every command that changes the grid to recording, Replay
+    //runs a recording's commands instead of the posted ones until it reaches its end tick.
+    void Record(Recording* recording);
+    void Replay(const Recording* recording);
+
+    void Start();
+    void Stop(); //Finishes the current tick, the grid can be used again after this returns
+
+    void Post(const SimCommand& command);
+    void SetBrush(const BrushInput& brush); //Posts a BRUSH command when the brush changed
+    void Reset();
+    void Save(const std::string& path);
+    void Load(const std::string& path);
+    void Pan(int dy, int dx);
+
+    //Newest published snapshot, nullptr if nothing was published since the last call.
+    //The snapshot stays valid (and unchanged) until the next call.
+    const GridSnapshot* AcquireSnapshot();
+
+    uint64_t TicksRun() const { return ticksRun.load(std::memory_order_relaxed); }
+
+private:
+    void Run();
+    void ApplyCommands();
+    void Publish();
+
+    CellGrid& Grid;
+    std::thread thread;
+    std::atomic<bool> running{ false };
+    std::atomic<uint64_t> ticksRun{ 0 };
+
+    //Input queue, filled by the main thread and emptied at the start of a tick
+    std::mutex commandLock;
+    std::vector<SimCommand> commands;
+    std::vector<SimCommand> applying; //Sim thread only
+    BrushInput brush; //Sim thread only
+    BrushInput postedBrush; //Main thread only
+
+    Recording* recorder = nullptr;
+    const Recording* replaying = nullptr;
+    std::unique_ptr<Replayer> replayer;
+
+    //Triple buffer: the sim fills back, swaps it with ready, the reader swaps ready with front
+    GridSnapshot snapshots[3];
+    DirtyRect stale[3]; //Sim thread only, cells a buffer is behind the live grid by
+    int back = 0;
+    int ready = 1;
+    int front = 2;
+    bool readyFresh = false; //ready holds a snapshot the reader hasn't taken yet
+    std::mutex swapLock;
+};
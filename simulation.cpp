@@ -1,56 +1,27 @@
-#define SDL_MAIN_HANDLED
-#define NUM_MATERIALS 6
-
 // C++ Standard Libraries
 #include <iostream>
 #include <vector>
 #include <algorithm>
 #include <string>
-
-// Third Party
-#include <SDL.h>
-#include <SDL_ttf.h>
+#include <memory>
+#include <functional>
 
 #include "constants.h"
-
-#pragma region Structs & Enums
-
-enum class CellState {
-    EMPTY = 0,
-    SAND,
-    ROCK,
-    BEDROCK,
-    WATER,
-    ACID
-};
-
-struct Material {
-    SDL_Color color[NUM_MATERIALS]; //Dry color of particle
-    SDL_Color WetColor[NUM_MATERIALS]; //Wet color of the particle
-    bool SubmersableInLiquid[NUM_MATERIALS]; //Is the particle submersible in lquid or does it just fall in air?
-    bool Liquid[NUM_MATERIALS]; //Is particle a liquid? (if not, then solid)
-    int Density[NUM_MATERIALS]; //Density of material
-    int ReactionDelay[NUM_MATERIALS]; //Combo delays (frame delay)
-    int FallSpeed[NUM_MATERIALS]; //Gravity for material
-};
-
-struct Cell {
-    CellState state; //Cell state, sand, water, etc.
-    uint8_t wetness = 0; //Wetness value, 0 = dry, 100 = fully wet.
-    uint8_t comboTimer = 0; //Combo timers per cell for delays.
-};
-
-#pragma endregion
+#include "simulation.h"
+#include "threadpool.h"
+#include "kernels.h"
+#include "materials.h"
+#include "trace.h"
+#include "world.h"
+#include "leveling.h"
 
 #pragma region Script Variables
-Material materials;
 CellState AddableMaterials[] = { CellState::SAND, CellState::WATER, CellState::ROCK, CellState::ACID };
 
 int CurrMaterialIndex = 0; //Initial material is sand
 
-CellState ComboTable[NUM_MATERIALS][NUM_MATERIALS];
-
-int selection_size = SELECTION_SIZE;
+std::unique_ptr<ThreadPool> UpdatePool(new ThreadPool(1)); //Single threaded until SetUpdateThreads
+std::vector<int> PassChunks; //Awake chunks in the current checkerboard pass
 #pragma endregion
 
 #pragma region Helper Functions
@@ -66,120 +37,33 @@ T clamp(T val, T min, T max) {
 #pragma endregion
 
 #pragma region Initializations
-CellState ChooseRandomState(CellState State1, CellState State2) {
-    if (rand() % 2) return State1;
-    else return State2;
-}
-
-void UpdateComboTable() {
-    ComboTable[(int)CellState::SAND][(int)CellState::ACID] = ChooseRandomState(CellState::ACID, CellState::EMPTY);
-    ComboTable[(int)CellState::WATER][(int)CellState::ACID] = ChooseRandomState(CellState::ACID, CellState::EMPTY);
-    ComboTable[(int)CellState::ROCK][(int)CellState::ACID] = ChooseRandomState(CellState::ACID, CellState::EMPTY);
-}
-
-
-void InitComboTable() {
-    for (int i = 0; i < NUM_MATERIALS; i++) {
-        for (int j = 0; j < NUM_MATERIALS; j++) {
-            ComboTable[i][j] = (CellState)i;
-        }
-    }
-
-    UpdateComboTable();
-}
-
-void InitializeColors() {
-    //Initialize Colors
-    materials.color[static_cast<int>(CellState::EMPTY)] = { 13, 13, 13, 255 };
-    materials.color[static_cast<int>(CellState::SAND)] = { 226, 202, 118, 128 };
-    materials.color[static_cast<int>(CellState::ROCK)] = { 33, 33, 33, 255 };
-    materials.color[(int)CellState::BEDROCK] = { 10, 10, 10, 255 };
+void ResetGrid(CellGrid& Grid) {
+    //A window onto a sparse world is open at the edges
+    bool Border = !WorldOpen();
 
-    materials.color[static_cast<int>(CellState::WATER)] = { 0, 84, 119, 255 };
-    materials.color[static_cast<int>(CellState::ACID)] = { 176, 191, 26, 255 };
-
-    //Initialize Wet Colors
-    materials.WetColor[static_cast<int>(CellState::EMPTY)] = { 13, 13, 13, 255 };
-    materials.WetColor[static_cast<int>(CellState::SAND)] = { 145, 129, 73, 255 };
-    materials.WetColor[static_cast<int>(CellState::ROCK)] = { 15, 15, 15, 255 };
-    materials.WetColor[(int)CellState::BEDROCK] = { 10, 10, 10, 255 };
-
-    materials.WetColor[static_cast<int>(CellState::WATER)] = { 0, 84, 119, 255 };
-    materials.WetColor[static_cast<int>(CellState::ACID)] = { 176, 191, 26, 255 };
-}
-
-void InitializeMaterials() {
-    //Separate function in case we want to reset random colors.
-    InitializeColors();
-
-    //Initialize Submersable
-    materials.SubmersableInLiquid[static_cast<int>(CellState::EMPTY)] = false;
-    materials.SubmersableInLiquid[static_cast<int>(CellState::SAND)] = true;
-    materials.SubmersableInLiquid[static_cast<int>(CellState::ROCK)] = false;
-    materials.SubmersableInLiquid[(int)CellState::BEDROCK] = false;
-
-    materials.SubmersableInLiquid[static_cast<int>(CellState::WATER)] = true;
-    materials.SubmersableInLiquid[static_cast<int>(CellState::ACID)] = true;
-
-    //Initialize State (Default is Solid)
-    materials.Liquid[static_cast<int>(CellState::EMPTY)] = false;
-    materials.Liquid[static_cast<int>(CellState::SAND)] = false;
-    materials.Liquid[static_cast<int>(CellState::ROCK)] = false;
-    materials.Liquid[(int)CellState::BEDROCK] = false;
-
-    materials.Liquid[static_cast<int>(CellState::WATER)] = true;
-    materials.Liquid[static_cast<int>(CellState::ACID)] = true;
-
-    //Initialize Densities
-    materials.Density[static_cast<int>(CellState::EMPTY)] = 0;
-    materials.Density[static_cast<int>(CellState::SAND)] = 5;
-    materials.Density[static_cast<int>(CellState::ROCK)] = 10;
-    materials.Density[(int)CellState::BEDROCK] = 500;
-
-    materials.Density[static_cast<int>(CellState::WATER)] = 3;
-    materials.Density[static_cast<int>(CellState::ACID)] = 4;
-
-    //Initialize Combo Delays
-    materials.ReactionDelay[static_cast<int>(CellState::EMPTY)] = 0;
-    materials.ReactionDelay[static_cast<int>(CellState::SAND)] = 5;
-    materials.ReactionDelay[static_cast<int>(CellState::ROCK)] = 150;
-    materials.ReactionDelay[(int)CellState::BEDROCK] = 500;
-
-    materials.ReactionDelay[static_cast<int>(CellState::WATER)] = 5;
-    materials.ReactionDelay[static_cast<int>(CellState::ACID)] = 5;
-
-    //Initialize Gravities
-    materials.FallSpeed[static_cast<int>(CellState::EMPTY)] = 0;
-    materials.FallSpeed[static_cast<int>(CellState::SAND)] = 1;
-    materials.FallSpeed[static_cast<int>(CellState::ROCK)] = 0;
-    materials.FallSpeed[(int)CellState::BEDROCK] = 0;
-
-    materials.FallSpeed[static_cast<int>(CellState::WATER)] = 1;
-    materials.FallSpeed[static_cast<int>(CellState::ACID)] = 1;
-}
-
-void InitializeGrid(Cell Grid[GRID_LENGTH][GRID_WIDTH]) {
-    for (int y = 0; y < GRID_LENGTH; y++)
+    for (int y = 0; y < Grid.Length(); y++)
     {
-        for (int x = 0; x < GRID_WIDTH; x++)
+        for (int x = 0; x < Grid.Width(); x++)
         {
-            Cell CurrCell = Grid[y][x];
+            Cell CurrCell;
 
-            if (x == (GRID_WIDTH - 1) || x == 0 || y == (GRID_LENGTH - 1) || y == 0) {
+            if (Border && (x == (Grid.Width() - 1) || x == 0 || y == (Grid.Length() - 1) || y == 0)) {
                 CurrCell.state = CellState::BEDROCK;
-                CurrCell.comboTimer = materials.ReactionDelay[static_cast<int>(CellState::BEDROCK)];
+                CurrCell.comboTimer = ReactionDelay(CellState::BEDROCK);
             }
 
             else {
                 CurrCell.state = CellState::EMPTY;
-                CurrCell.comboTimer = materials.ReactionDelay[static_cast<int>(CellState::EMPTY)];
+                CurrCell.comboTimer = ReactionDelay(CellState::EMPTY);
             }
 
             CurrCell.wetness = 0;
 
-            Grid[y][x] = CurrCell;
+            Grid.Set(y, x, CurrCell);
         }
     }
+
+    Grid.WakeAll();
 }
 
 #pragma endregion
@@ -191,6 +75,7 @@ const std::string CellStateToString(CellState state) {
     case CellState::EMPTY: return "EMPTY";
     case CellState::SAND: return "SAND";
     case CellState::ROCK: return "ROCK";
+    case CellState::BEDROCK: return "BEDROCK";
     case CellState::WATER: return "WATER";
     case CellState::ACID: return "ACID";
     default: return "UNKNOWN";
@@ -202,12 +87,11 @@ void CurrentMaterialCheck() {
     std::cout << "Current Mateirla: " << CellStateToString(AddableMaterials[CurrMaterialIndex]) << "\n";
 }
 
-void ComboLookupTableString(CellState ComboTable[NUM_MATERIALS][NUM_MATERIALS]) {
-    for (int y = 0; y < NUM_MATERIALS; y++) {
-        for (int x = 0; x < NUM_MATERIALS; x++) {
-            std::cout << "(" << CellStateToString(static_cast<CellState>(x)) << ", " << CellStateToString(static_cast<CellState>(y)) << ") : "
-                << CellStateToString(ComboTable[y][x]) << "\n";
-        }
+void ReactionTableString() {
+    for (const ReactionRule& rule : ReactionRules) {
+        std::cout << "(" << CellStateToString(rule.cell) << ", " << CellStateToString(rule.neighbor) << ") : "
+            << CellStateToString(rule.reaction.outcome) << " " << (int)rule.reaction.chance << "%, otherwise "
+            << CellStateToString(rule.reaction.alternate) << "\n";
     }
 }
 
@@ -215,7 +99,7 @@ void OutputContacts(Cell& CurrCell, Cell& OtherCell) {
     if (OtherCell.state != CurrCell.state) {
         std::cout << CellStateToString(CurrCell.state) << " Contacted " << CellStateToString(OtherCell.state) << "\n";
         std::cout << "Current Cell's Combo Timer: " << (int)CurrCell.comboTimer << "\n";
-        std::cout << "Current State's Delay: " << materials.ReactionDelay[static_cast<int>(CurrCell.state)] << "\n\n";
+        std::cout << "Current State's Delay: " << ReactionDelay(CurrCell.state) << "\n\n";
     }
 }
 
@@ -223,285 +107,474 @@ void OutputContacts(Cell& CurrCell, Cell& OtherCell) {
 
 #pragma region Grid Operations
 
-SDL_Color LerpColor(const SDL_Color& a, const SDL_Color& b, float t) { //where t is the wetness/100
-    SDL_Color result;
-
-    result.r = a.r + (b.r - a.r) * t;
-    result.g = a.g + (b.g - a.g) * t;
-    result.b = a.b + (b.b - a.b) * t;
-    result.a = a.a + (b.a - a.a) * t;;
-
-    return result;
-}
-
-SDL_Color Darken_Color(SDL_Color Color, Uint8 DarknessFac) {
-    return {
-        static_cast<Uint8>(std::max(0, Color.r - DarknessFac)),
-        static_cast<Uint8>(std::max(0, Color.g - DarknessFac)),
-        static_cast<Uint8>(std::max(0, Color.b - DarknessFac)),
-        Color.a
-    };
-}
-
 //Check if particaly actually has a combo
-bool CanChangeState(Cell& CurrCell, Cell& OtherCell) {
+inline bool CanChangeState(Cell& CurrCell, Cell& OtherCell, Rng& rng) {
 
     //Wetness from direct contact with liquid
-    if (materials.Liquid[(int)OtherCell.state]) {
-        CurrCell.wetness = std::min(CurrCell.wetness + 5, 100);
+    if (IsLiquid(OtherCell.state)) {
+        CurrCell.wetness = std::min(CurrCell.wetness + 5, static_cast<int>(MAX_WETNESS));
     }
 
-    //Wetness spread from a wet neighbor
-    if (OtherCell.wetness > 80) {
-        CurrCell.wetness = std::min(CurrCell.wetness + 1, 100);
+    //Wetness spread from a wetter neighbor
+    if (OtherCell.wetness > 80 && OtherCell.wetness > CurrCell.wetness) {
+        CurrCell.wetness = std::min(CurrCell.wetness + 1, static_cast<int>(MAX_WETNESS));
 
-        //Rare drying of neighbor
-        if (rand() % 10 == 0) {
+        //Rare drying of neighbor, liquid is as wet as it gets and stays that way
+        if (!IsLiquid(OtherCell.state) && rng.OneIn(10)) {
             OtherCell.wetness = std::max(OtherCell.wetness - 2, 0);
         }
     }
 
-    //Gradual drying if not near liquid
-    if (!materials.Liquid[(int)OtherCell.state] && !materials.Liquid[(int)CurrCell.state]) {
-        if (rand() % 300 == 0) { // slow drying
+    //Gradual drying into a drier neighbor if not near liquid. Evenly wet particles keep their
+    //water, so a soaked bed settles instead of drying and rewetting itself forever. Bedrock never
+    //takes any up, it would be a sink the bed keeps drying into.
+    if (!IsLiquid(OtherCell.state) && !IsLiquid(CurrCell.state) && OtherCell.state != CellState::BEDROCK &&
+        OtherCell.wetness < CurrCell.wetness) {
+        if (rng.OneIn(300)) { // slow drying
             CurrCell.wetness = std::max(CurrCell.wetness - 1, 0);
         }
     }
 
     if (CurrCell.comboTimer > 0 || OtherCell.comboTimer > 0) return false;
 
-    if (CurrCell.comboTimer <= 0 && CurrCell.state != CellState::EMPTY && OtherCell.state != CellState::EMPTY && CurrCell.state != OtherCell.state) {
-        CellState oldState = CurrCell.state;
+    //Only pairs with a reaction roll (and start their timers)
+    const Reaction& reaction = GetReaction(CurrCell.state, OtherCell.state);
+    if (!reaction.reacts) return false;
 
-        CurrCell.state = ComboTable[(int)CurrCell.state][(int)OtherCell.state];
+    CellState oldState = CurrCell.state;
 
-        CurrCell.comboTimer = materials.ReactionDelay[(int)oldState];
-        OtherCell.comboTimer = materials.ReactionDelay[(int)CurrCell.state];
+    CurrCell.state = rng.Below(100) < reaction.chance ? reaction.outcome : reaction.alternate;
 
-        return true;
+    CurrCell.comboTimer = ReactionDelay(oldState);
+    OtherCell.comboTimer = ReactionDelay(CurrCell.state);
+
+    return true;
+}
+
+//Run a combo check between two cells and wake whichever of them changed
+bool TryCombo(CellGrid& Grid, Rng& rng, int Curr_y, int Curr_x, int Other_y, int Other_x) {
+    Cell CurrCell = Grid.Get(Curr_y, Curr_x);
+    Cell OtherCell = Grid.Get(Other_y, Other_x);
+
+    Cell OldCurr = CurrCell;
+    Cell OldOther = OtherCell;
+
+    bool Changed = CanChangeState(CurrCell, OtherCell, rng);
+
+    if (CurrCell != OldCurr) {
+        Grid.Set(Curr_y, Curr_x, CurrCell);
+        Grid.WakeCell(Curr_y, Curr_x);
     }
 
+    if (OtherCell != OldOther) {
+        Grid.Set(Other_y, Other_x, OtherCell);
+        Grid.WakeCell(Other_y, Other_x);
+    }
 
-    return false;
+    return Changed;
 }
 
 //Check particle neighbors for combinations
-void CheckForCombos(Cell(&Grid)[GRID_LENGTH][GRID_WIDTH], int Curr_y, int Curr_x) {
-    Cell& CurrCell = Grid[Curr_y][Curr_x];
-
-    if (CurrCell.comboTimer > 0) {
+void CheckForCombos(CellGrid& Grid, Rng& rng, int Curr_y, int Curr_x) {
+    if (Grid.ComboTimer(Curr_y, Curr_x) > 0) {
         return;
     }
 
-    Cell& UpperCell = Grid[Curr_y - 1][Curr_x];
-    Cell& LowerCell = Grid[Curr_y + 1][Curr_x];
-    Cell& RightCell = Grid[Curr_y][Curr_x + 1];
-    Cell& LeftCell = Grid[Curr_y][Curr_x - 1];
-
-    if (CanChangeState(CurrCell, UpperCell)) {
+    if (TryCombo(Grid, rng, Curr_y, Curr_x, Curr_y - 1, Curr_x)) { //Upper
         return;
     }
 
-    else if (CanChangeState(CurrCell, LowerCell)) {
+    else if (TryCombo(Grid, rng, Curr_y, Curr_x, Curr_y + 1, Curr_x)) { //Lower
         return;
     }
 
-    else if (CanChangeState(CurrCell, RightCell)) {
+    else if (TryCombo(Grid, rng, Curr_y, Curr_x, Curr_y, Curr_x + 1)) { //Right
         return;
     }
 
-    else if (CanChangeState(CurrCell, LeftCell)) {
+    else if (TryCombo(Grid, rng, Curr_y, Curr_x, Curr_y, Curr_x - 1)) { //Left
         return;
     }
 }
 
-//Try moving the particle
-bool TryMove(Cell& CurrCell, Cell& OtherCell) {
-    bool& IsCurrSubmersibleInLiquids = materials.SubmersableInLiquid[static_cast<int>(CurrCell.state)];
-    bool& isOtherLiquid = materials.Liquid[static_cast<int>(OtherCell.state)];
+//Try moving a particle of State into the other cell
+template <CellState State>
+bool TryMove(CellGrid& Grid, Rng& rng, int Curr_y, int Curr_x, int Other_y, int Other_x) {
+    CellState OtherState = Grid.State(Other_y, Other_x);
 
-    int& currDensity = materials.Density[(int)CurrCell.state];
-    int& otherDensity = materials.Density[(int)OtherCell.state];
+    if (OtherState == CellState::EMPTY) {
+        Grid.MoveState(Curr_y, Curr_x, Other_y, Other_x);
 
-    if (OtherCell.state == CellState::EMPTY) {
-        OtherCell.state = CurrCell.state;
-        CurrCell.state = CellState::EMPTY;
+        Grid.WakeCell(Curr_y, Curr_x);
+        Grid.WakeCell(Other_y, Other_x);
 
         return true;
     }
 
-    else if ((IsCurrSubmersibleInLiquids && isOtherLiquid) && (currDensity > otherDensity)) {
+    else if (SinksInto(State, OtherState)) {
 
-        if (rand() % 200 == 0) {
-            OtherCell.state = CurrCell.state;
-            CurrCell.state = CellState::EMPTY;
+        //The liquid is pushed out of existence
+        if (rng.OneIn(200)) {
+            Grid.SetState(Other_y, Other_x, State);
+            Grid.SetState(Curr_y, Curr_x, CellState::EMPTY);
         }
 
         else {
-            std::swap(CurrCell, OtherCell);
+            Grid.Swap(Curr_y, Curr_x, Other_y, Other_x);
         }
 
+        Grid.WakeCell(Curr_y, Curr_x);
+        Grid.WakeCell(Other_y, Other_x);
+
         return true;
     }
 
     return false;
 }
 
-//Update Sand Particle Function
-void UpdateSandParticle(Cell(&Grid)[GRID_LENGTH][GRID_WIDTH], int& Curr_y, int& Curr_x) {
-    Cell& CurrCell = Grid[Curr_y][Curr_x];
+//Empty cells in a straight line from (Curr_y, Curr_x) in direction (dy, dx), up to Reach.
+//Stops at the first cell that isn't empty or is off the grid.
+int FreeDistance(const CellGrid& Grid, int Curr_y, int Curr_x, int dy, int dx, int Reach) {
+    int Distance = 0;
+
+    while (Distance < Reach) {
+        int y = Curr_y + dy * (Distance + 1);
+        int x = Curr_x + dx * (Distance + 1);
+
+        if (!Grid.InBounds(y, x) || Grid.State(y, x) != CellState::EMPTY) break;
+
+        Distance++;
+    }
+
+    return Distance;
+}
+
+//Fall through the empty cells below as far as the particle's velocity carries it this tick, at
+//least one cell. Speeds up by the material's fallSpeed while nothing is in the way, and slows to
+//the distance it managed when it lands on something.
+template <CellState State>
+void Fall(CellGrid& Grid, int Curr_y, int Curr_x) {
+    int Velocity = Grid.Velocity(Curr_y, Curr_x);
+    int Reach = std::max(Velocity, 1);
+    int Distance = FreeDistance(Grid, Curr_y, Curr_x, 1, 0, Reach);
+
+    int Speed = Distance < Reach ? Distance : std::min(Velocity + GetMaterial(State).fallSpeed, static_cast<int>(MAX_VELOCITY));
+    int Lower_y = Curr_y + Distance;
+
+    Grid.MoveState(Curr_y, Curr_x, Lower_y, Curr_x);
+    if (Speed != Velocity) Grid.SetVelocity(Lower_y, Curr_x, static_cast<uint8_t>(Speed));
 
-    Cell& RightLowerCell = Grid[Curr_y + 1][Curr_x + 1];
-    Cell& LeftLowerCell = Grid[Curr_y + 1][Curr_x - 1];
-    Cell& LowerCell = Grid[Curr_y + 1][Curr_x];
+    Grid.WakeCell(Curr_y, Curr_x);
+    Grid.WakeCell(Lower_y, Curr_x);
+}
+
+//Move sideways to the furthest empty cell within the material's dispersion, or sink sideways
+//into the liquid next to it. Only spreads where that makes the liquid lower: over an edge, or off
+//the top of a stack onto something that isn't liquid. Evening out the surface of a body is left
+//to LevelLiquids, so a level body stops moving and can sleep.
+template <CellState State>
+bool TrySpread(CellGrid& Grid, Rng& rng, int Curr_y, int Curr_x, int dx) {
+    int Distance = FreeDistance(Grid, Curr_y, Curr_x, 0, dx, GetMaterial(State).dispersion);
 
-    bool CanGoLowRight = true;
-    bool CanGoLowLeft = true;
+    if (Distance == 0) return TryMove<State>(Grid, rng, Curr_y, Curr_x, Curr_y, Curr_x + dx);
 
-    if (Curr_x == 1) CanGoLowLeft = false;
-    if (Curr_x == GRID_WIDTH - 1) CanGoLowRight = false;
+    int Lower_y = Curr_y + 1;
 
-    if (LowerCell.state == CellState::EMPTY) {
-        if (TryMove(CurrCell, LowerCell)) return;
+    //Drop into the first gap on the way
+    for (int step = 1; step < Distance; step++) {
+        if (Grid.State(Lower_y, Curr_x + dx * step) == CellState::EMPTY) {
+            Distance = step;
+            break;
+        }
     }
 
-    else {
-        if (rand() % 2) {
-            if (CanGoLowRight && TryMove(CurrCell, RightLowerCell)) return;
-            if (CanGoLowLeft && TryMove(CurrCell, LeftLowerCell)) return;
+    int Other_x = Curr_x + dx * Distance;
+    CellState Below = Grid.State(Lower_y, Other_x);
+
+    bool Lowers = Below == CellState::EMPTY || (IsLiquid(Grid.State(Lower_y, Curr_x)) && !IsLiquid(Below));
+    if (!Lowers) return false;
+
+    Grid.MoveState(Curr_y, Curr_x, Curr_y, Other_x);
+
+    Grid.WakeCell(Curr_y, Curr_x);
+    Grid.WakeCell(Curr_y, Other_x);
+
+    return true;
+}
+
+//Landed, or never fell
+void StopFalling(CellGrid& Grid, int Curr_y, int Curr_x) {
+    if (Grid.Velocity(Curr_y, Curr_x) != 0) Grid.SetVelocity(Curr_y, Curr_x, 0);
+}
+
+//Movement kernels, one per MoveClass. Updated cells are never on the grid's outer ring, so every
+//neighbor is in the grid. Longer moves are traced cell by cell (FreeDistance) and stay within
+//MAX_REACH of the particle.
+template <MoveClass Move, CellState State>
+struct MoveKernel;
+
+//Never moves
+template <CellState State>
+struct MoveKernel<MoveClass::STATIC, State> {
+    static void Update(CellGrid&, Rng&, int, int) {}
+};
+
+//Falls straight down, else diagonally
+template <CellState State>
+struct MoveKernel<MoveClass::POWDER, State> {
+    static void Update(CellGrid& Grid, Rng& rng, int Curr_y, int Curr_x) {
+        int Lower_y = Curr_y + 1;
+        int Left_x = Curr_x - 1;
+        int Right_x = Curr_x + 1;
+
+        if (Grid.State(Lower_y, Curr_x) == CellState::EMPTY) {
+            Fall<State>(Grid, Curr_y, Curr_x);
         }
+
         else {
-            if (CanGoLowLeft && TryMove(CurrCell, LeftLowerCell)) return;
-            if (CanGoLowRight && TryMove(CurrCell, RightLowerCell)) return;
-        }
+            StopFalling(Grid, Curr_y, Curr_x);
+
+            if (rng.CoinFlip()) {
+                if (TryMove<State>(Grid, rng, Curr_y, Curr_x, Lower_y, Right_x)) return;
+                if (TryMove<State>(Grid, rng, Curr_y, Curr_x, Lower_y, Left_x)) return;
+            }
+            else {
+                if (TryMove<State>(Grid, rng, Curr_y, Curr_x, Lower_y, Left_x)) return;
+                if (TryMove<State>(Grid, rng, Curr_y, Curr_x, Lower_y, Right_x)) return;
+            }
 
-        if (TryMove(CurrCell, LowerCell)) return;
+            if (TryMove<State>(Grid, rng, Curr_y, Curr_x, Lower_y, Curr_x)) return;
+        }
     }
-}
+};
 
-//Update Water Particle Function
-void UpdateWaterParticle(Cell(&Grid)[GRID_LENGTH][GRID_WIDTH], int& Curr_y, int& Curr_x) {
-    Cell& CurrCell = Grid[Curr_y][Curr_x];
+//Falls like a powder, then spreads sideways
+template <CellState State>
+struct MoveKernel<MoveClass::LIQUID, State> {
+    static void Update(CellGrid& Grid, Rng& rng, int Curr_y, int Curr_x) {
+        int Lower_y = Curr_y + 1;
+        int Left_x = Curr_x - 1;
+        int Right_x = Curr_x + 1;
 
-    Cell& RightLowerCell = Grid[Curr_y + 1][Curr_x + 1];
-    Cell& LeftLowerCell = Grid[Curr_y + 1][Curr_x - 1];
-    Cell& LowerCell = Grid[Curr_y + 1][Curr_x];
+        if (Grid.State(Lower_y, Curr_x) == CellState::EMPTY) {
+            Fall<State>(Grid, Curr_y, Curr_x);
+        }
 
-    Cell& RightCell = Grid[Curr_y][Curr_x + 1];
-    Cell& LeftCell = Grid[Curr_y][Curr_x - 1];
+        else {
+            StopFalling(Grid, Curr_y, Curr_x);
 
-    bool CanGoLowRight = true;
-    bool CanGoLowLeft = true;
+            if (rng.CoinFlip()) {
+                if (TryMove<State>(Grid, rng, Curr_y, Curr_x, Lower_y, Right_x)) return;
+                if (TryMove<State>(Grid, rng, Curr_y, Curr_x, Lower_y, Left_x)) return;
 
-    if (Curr_x == 1) CanGoLowLeft = false;
-    if (Curr_x == GRID_WIDTH - 1) CanGoLowRight = false;
+                if (TrySpread<State>(Grid, rng, Curr_y, Curr_x, 1)) return;
+                if (TrySpread<State>(Grid, rng, Curr_y, Curr_x, -1)) return;
+            }
 
-    if (LowerCell.state == CellState::EMPTY) {
-        if (TryMove(CurrCell, LowerCell)) return;
+            else {
+                if (TryMove<State>(Grid, rng, Curr_y, Curr_x, Lower_y, Left_x)) return;
+                if (TryMove<State>(Grid, rng, Curr_y, Curr_x, Lower_y, Right_x)) return;
+
+                if (TrySpread<State>(Grid, rng, Curr_y, Curr_x, -1)) return;
+                if (TrySpread<State>(Grid, rng, Curr_y, Curr_x, 1)) return;
+            }
+
+            if (TryMove<State>(Grid, rng, Curr_y, Curr_x, Lower_y, Curr_x)) return;
+        }
     }
+};
 
-    else {
-        if (rand() % 2) {
-            if (CanGoLowRight && TryMove(CurrCell, RightLowerCell)) return;
-            if (CanGoLowLeft && TryMove(CurrCell, LeftLowerCell)) return;
+//Very wet particles lose water to the air around them
+void DryInAir(CellGrid& Grid, Rng& rng, int Curr_y, int Curr_x) {
+    uint8_t Wetness = Grid.Wetness(Curr_y, Curr_x);
+    uint8_t Before = Wetness;
+
+    const int Offsets[4][2] = { { -1, 0 }, { 1, 0 }, { 0, 1 }, { 0, -1 } };
 
-            if (TryMove(CurrCell, RightCell)) return;
-            if (TryMove(CurrCell, LeftCell)) return;
+    for (const auto& Offset : Offsets) {
+        if (Wetness > 80 && Grid.State(Curr_y + Offset[0], Curr_x + Offset[1]) == CellState::EMPTY && rng.OneIn(10)) {
+            Wetness = std::max(Wetness - 2, 0);
         }
+    }
 
-        else {
-            if (CanGoLowLeft && TryMove(CurrCell, LeftLowerCell)) return;
-            if (CanGoLowRight && TryMove(CurrCell, RightLowerCell)) return;
+    if (Wetness != Before) {
+        Grid.SetWetness(Curr_y, Curr_x, Wetness);
+        Grid.WakeCell(Curr_y, Curr_x);
+    }
+}
+
+//Full update of a particle of State, built once per material
+template <CellState State>
+void UpdateParticle(CellGrid& Grid, Rng& rng, int Curr_y, int Curr_x) {
+    MoveKernel<GetMaterial(State).move, State>::Update(Grid, rng, Curr_y, Curr_x);
+
+    //Only if the particle is still here: a move leaves an empty cell behind, and sinking swaps
+    //the liquid it sank through into this spot
+    if (!IsLiquid(State) && Grid.State(Curr_y, Curr_x) == State && Grid.Wetness(Curr_y, Curr_x) > 80) {
+        DryInAir(Grid, rng, Curr_y, Curr_x);
+    }
+
+    CheckForCombos(Grid, rng, Curr_y, Curr_x);
+}
+
+using UpdateFn = void (*)(CellGrid&, Rng&, int, int);
+
+//Update kernel per CellState. EMPTY and BEDROCK never go on a worklist (see CanUpdate) and have none.
+const UpdateFn UpdateTable[NUM_MATERIALS] = {
+    nullptr, //EMPTY
+    UpdateParticle<CellState::SAND>,
+    UpdateParticle<CellState::ROCK>, //Static, but still reacts with its neighbors
+    nullptr, //BEDROCK
+    UpdateParticle<CellState::WATER>,
+    UpdateParticle<CellState::ACID>,
+};
+
+//Count down the combo timers of a rect, one row at a time
+void UpdateComboTimers(CellGrid& Grid, const DirtyRect& rect) {
+    int Span = rect.maxX - rect.minX + 1;
 
-            if (TryMove(CurrCell, LeftCell)) return;
-            if (TryMove(CurrCell, RightCell)) return;
+    for (int y = rect.minY; y <= rect.maxY; y++) {
+        if (DecrementComboTimers(Grid.ComboTimerRow(y) + rect.minX, Span)) {
+            //Keep ticking (and wake the neighbors once they run out)
+            Grid.WakeRect(y - 1, rect.minX - 1, y + 1, rect.maxX + 1);
         }
+    }
+}
+
+//Reset the wetness left behind in cells that are now empty
+void DryEmptyCells(CellGrid& Grid, const DirtyRect& rect) {
+    int Span = rect.maxX - rect.minX + 1;
 
-        if (TryMove(CurrCell, LowerCell)) return;
+    for (int y = rect.minY; y <= rect.maxY; y++) {
+        ClearEmptyWetness(Grid.WordRow(y) + rect.minX, Span);
     }
 }
 
-void UpdateParticle(Cell(&Grid)[GRID_LENGTH][GRID_WIDTH], int& Curr_y, int& Curr_x) {
-    switch (Grid[Curr_y][Curr_x].state) {
-    case CellState::SAND:
-        UpdateSandParticle(Grid, Curr_y, Curr_x);
-        break;
+//Can a particle's wetness still change without a neighbor changing first: it's still soaking up a
+//liquid it touches, drawing water from a wetter neighbor, or drying into a drier one (see CanChangeState)
+bool WetnessCanChange(const CellGrid& Grid, int Curr_y, int Curr_x) {
+    uint8_t Wetness = Grid.Wetness(Curr_y, Curr_x);
+
+    const int Offsets[4][2] = { { -1, 0 }, { 1, 0 }, { 0, 1 }, { 0, -1 } };
+
+    for (const auto& Offset : Offsets) {
+        int Other_y = Curr_y + Offset[0], Other_x = Curr_x + Offset[1];
+        uint8_t OtherWetness = Grid.Wetness(Other_y, Other_x);
 
-    case CellState::WATER:
-        UpdateWaterParticle(Grid, Curr_y, Curr_x);
-        break;
+        if (IsLiquid(Grid.State(Other_y, Other_x))) {
+            if (Wetness < MAX_WETNESS) return true;
+        }
 
-    case CellState::ACID:
-        UpdateWaterParticle(Grid, Curr_y, Curr_x);
-        break;
+        else if ((OtherWetness < Wetness && Grid.State(Other_y, Other_x) != CellState::BEDROCK) || (OtherWetness > 80 && OtherWetness > Wetness)) {
+            return true;
+        }
     }
 
-    CheckForCombos(Grid, Curr_y, Curr_x);
+    return false;
 }
 
-void UpdateComboTimer(Cell& CurrCell) {
-    if (CurrCell.comboTimer > 0) {
-        CurrCell.comboTimer--;
+//Update one particle off the worklist
+void UpdateActiveCell(CellGrid& Grid, Rng& rng, int Curr_y, int Curr_x) {
+    //Moved away or changed since it was queued
+    UpdateFn Update = UpdateTable[static_cast<int>(Grid.State(Curr_y, Curr_x))];
+    if (!Update) return;
+
+    Update(Grid, rng, Curr_y, Curr_x);
+
+    //Wet particles keep soaking up or drying out, keep them on the list until they settle (liquids
+    //never dry). Once settled they wait for a neighbor to change instead.
+    CellState State = Grid.State(Curr_y, Curr_x);
+
+    if (CanUpdate(State) && !IsLiquid(State) && Grid.Wetness(Curr_y, Curr_x) > 0 && WetnessCanChange(Grid, Curr_y, Curr_x)) {
+        Grid.KeepAwake(Curr_y, Curr_x);
     }
 }
 
-//Update Grid Values
-void PaintGrid(Cell(&Grid)[GRID_LENGTH][GRID_WIDTH]) {
-    for (int y = GRID_LENGTH - 2; y > 0; y--) {
-        if (rand() % 2) {
-            for (int x = 1; x < GRID_WIDTH - 1; x++) {
-                UpdateComboTimer(Grid[y][x]);
-                UpdateParticle(Grid, y, x);
+//Update the awake part of a chunk, bottom row first
+void UpdateChunk(CellGrid& Grid, Chunk& chunk) {
+    UpdateComboTimers(Grid, chunk.rect);
+
+    std::vector<uint32_t>& Active = chunk.active;
+    std::sort(Active.begin(), Active.end(), std::greater<uint32_t>()); //Bottom row first, right to left
+
+    size_t RowStart = 0;
+
+    while (RowStart < Active.size()) {
+        int y = static_cast<int>(Active[RowStart] / Grid.Stride());
+        uint32_t RowIndex = static_cast<uint32_t>(Grid.Index(y, 0));
+
+        size_t RowEnd = RowStart;
+        while (RowEnd < Active.size() && Active[RowEnd] >= RowIndex) RowEnd++;
+
+        if (chunk.rng.CoinFlip()) {
+            for (size_t i = RowEnd; i-- > RowStart;) {
+                UpdateActiveCell(Grid, chunk.rng, y, static_cast<int>(Active[i] - RowIndex));
             }
         }
 
         else {
-            for (int x = GRID_WIDTH - 1; x > 1; x--) {
-                UpdateComboTimer(Grid[y][x]);
-                UpdateParticle(Grid, y, x);
+            for (size_t i = RowStart; i < RowEnd; i++) {
+                UpdateActiveCell(Grid, chunk.rng, y, static_cast<int>(Active[i] - RowIndex));
             }
         }
+
+        RowStart = RowEnd;
     }
+
+    DryEmptyCells(Grid, chunk.rect);
 }
 
+//Update Grid Values
+//Chunks are updated in four checkerboard passes. A particle in a chunk only ever touches cells
+//at most MAX_REACH cells outside of it, and wakes one cell further, so chunks in the same pass
+//(a chunk apart) never share a cell and particles can still move across chunk borders. The
+//single threaded update runs the same passes, so a seed gives the same result for any thread count.
+void PaintGrid(CellGrid& Grid) {
+    static_assert(2 * (MAX_REACH + 1) <= CHUNK_SIZE, "Chunks in the same pass need a gap wider than two particle reaches");
 
-#pragma endregion
+    SAND_TRACE_SCOPE("PaintGrid");
 
-#pragma region Grid Drawers
+    Grid.BeginTick();
 
-//Create cell at location
-void CreateCell(SDL_Renderer* renderer, Cell& cell, int row, int col) {
-    if (cell.state != CellState::EMPTY) {
-        float wetFactor = std::max(0.0f, std::min(cell.wetness / 100.0f, 1.0f));
-        SDL_Color color = LerpColor(materials.color[static_cast<int>(cell.state)], materials.WetColor[static_cast<int>(cell.state)], wetFactor);
+    for (int pass = 0; pass < 4; pass++) {
+        int OffsetX = pass & 1;
+        int OffsetY = pass >> 1;
 
-        SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
-    }
+        PassChunks.clear();
 
-    else {
-        cell.wetness = 0;
-        SDL_SetRenderDrawColor(renderer, materials.color[static_cast<int>(cell.state)].r, materials.color[static_cast<int>(cell.state)].g, materials.color[static_cast<int>(cell.state)].b, materials.color[static_cast<int>(cell.state)].a);
+        for (int cy = Grid.ChunksY() - 1 - OffsetY; cy >= 0; cy -= 2) {
+            for (int cx = OffsetX; cx < Grid.ChunksX(); cx += 2) {
+                if (!Grid.GetChunk(cy, cx).rect.Empty()) {
+                    PassChunks.push_back(cy * Grid.ChunksX() + cx);
+                }
+            }
+        }
+
+        UpdatePool->ParallelFor(static_cast<int>(PassChunks.size()), [&Grid](int i) {
+            SAND_TRACE_SCOPE("UpdateChunk");
+            UpdateChunk(Grid, Grid.GetChunk(PassChunks[i]));
+        });
     }
 
-    SDL_Rect cellRect{ col * CELL_SIZE, row * CELL_SIZE, CELL_SIZE, CELL_SIZE };
-    SDL_RenderFillRect(renderer, &cellRect);
+    LevelLiquids(Grid, *UpdatePool);
 }
 
-void SpawnCell(Cell(&Grid)[GRID_LENGTH][GRID_WIDTH], CellState state) {
-    int MouseX, MouseY;
-    Uint32 mouseState = SDL_GetMouseState(&MouseX, &MouseY);
 
-    int CellX = MouseX / CELL_SIZE;
-    int CellY = MouseY / CELL_SIZE;
+#pragma endregion
+
+#pragma region Brush
 
-    for (int dy = -selection_size; dy <= selection_size; ++dy) {
-        for (int dx = -selection_size; dx <= selection_size; ++dx) {
-            int x = CellX + dx;
-            int y = CellY + dy;
+//Fill the empty cells in the brush square
+void SpawnCell(CellGrid& Grid, const BrushInput& Brush) {
+    for (int dy = -Brush.Size; dy <= Brush.Size; ++dy) {
+        for (int dx = -Brush.Size; dx <= Brush.Size; ++dx) {
+            int x = Brush.x + dx;
+            int y = Brush.y + dy;
 
-            if (x >= 0 && x < GRID_WIDTH && y >= 0 && y < GRID_LENGTH) {
-                if (Grid[y][x].state == CellState::EMPTY) {
-                    Grid[y][x].state = state;
+            if (Grid.InBounds(y, x)) {
+                if (Grid.State(y, x) == CellState::EMPTY) {
+                    Grid.SetState(y, x, Brush.Material);
+                    Grid.WakeCell(y, x);
                 }
             }
         }
@@ -511,50 +584,37 @@ void SpawnCell(Cell(&Grid)[GRID_LENGTH][GRID_WIDTH], CellState state) {
 #pragma region Wrapper Functions (For Bulk Running)
 
 //Update Grid
-void UpdateGrid(Cell(&Grid)[GRID_LENGTH][GRID_WIDTH], bool& LmbHeld) {
-    if (LmbHeld) {
-        SpawnCell(Grid, AddableMaterials[CurrMaterialIndex]);
+void UpdateGrid(CellGrid& Grid, const BrushInput& Brush) {
+    SAND_TRACE_SCOPE("UpdateGrid");
+
+    if (Brush.Active) {
+        SpawnCell(Grid, Brush);
     }
 
     PaintGrid(Grid);
+}
 
-    //Randomly shuffle the combos (since a few are randomly decided
-    if (rand() % 10 == 0) {
-        UpdateComboTable();
+//Initialization
+void SeedSimulation(CellGrid& Grid, uint64_t Seed) {
+    //One stream per chunk, so the result doesn't depend on which thread updates a chunk
+    for (int i = 0; i < Grid.ChunksX() * Grid.ChunksY(); i++) {
+        Grid.GetChunk(i).rng.Seed(Seed, static_cast<uint64_t>(i) + 1);
     }
 }
 
-//Render Grid
-void RenderGrid(SDL_Renderer* renderer, Cell(&Grid)[GRID_LENGTH][GRID_WIDTH]) {
-    SDL_RenderClear(renderer);
-
-    for (int row = 0; row < GRID_LENGTH; ++row) {
-        for (int col = 0; col < GRID_WIDTH; ++col) {
-            CreateCell(renderer, Grid[row][col], row, col);
-        }
-    }
+void InitializeSim(CellGrid& Grid, uint64_t Seed) {
+    SeedSimulation(Grid, Seed);
+    ResetGrid(Grid);
 }
 
-//Initialization
-void InitializeSim(Cell Grid[GRID_LENGTH][GRID_WIDTH]) {
-    InitializeGrid(Grid);
-    InitializeMaterials();
-    InitComboTable();
+CellState GetCurrentState() {
+    return AddableMaterials[CurrMaterialIndex];
 }
 
 std::string GetCurrentMaterial() {
     return CellStateToString(AddableMaterials[CurrMaterialIndex]);
 }
 
-void Set_Curr_Color(SDL_Color Color) {
-    materials.color[(int)AddableMaterials[CurrMaterialIndex]] = Color;
-    materials.WetColor[(int)AddableMaterials[CurrMaterialIndex]] = Darken_Color(Color, 30);
-}
-
-SDL_Color& Get_Curr_Color() {
-    return materials.color[(int)AddableMaterials[CurrMaterialIndex]];
-}
-
 std::vector<std::string> GetAddableMaterials() {
     std::vector<std::string> addables;
 
@@ -571,19 +631,19 @@ std::vector<std::string> GetAddableMaterials() {
 #pragma region Debug Methods
 
 //Debug Grid
-void ShowGrid(Cell Grid[GRID_LENGTH][GRID_WIDTH]) {
+void ShowGrid(CellGrid& Grid) {
 
     std::cout << "  ";
-    for (int col = 0; col < GRID_WIDTH; ++col) {
+    for (int col = 0; col < Grid.Width(); ++col) {
         std::cout << col % 10 << " ";
     }
     std::cout << "\n";
 
-    for (int row = 0; row < GRID_LENGTH; ++row) {
+    for (int row = 0; row < Grid.Length(); ++row) {
         std::cout << row << " ";
 
-        for (int col = 0; col < GRID_WIDTH; ++col) {
-            switch (Grid[row][col].state) {
+        for (int col = 0; col < Grid.Width(); ++col) {
+            switch (Grid.State(row, col)) {
             case CellState::EMPTY: std::cout << "  "; break;
             case CellState::SAND:  std::cout << "S "; break;
             case CellState::ROCK:  std::cout << "R "; break;
@@ -620,33 +680,8 @@ void Switch_Material(int index) {
     CurrMaterialIndex = index;
 }
 
-// Colored sand
-
-void Randomize_Color() {
-    materials.color[(int)AddableMaterials[CurrMaterialIndex]] = { static_cast<Uint8>(rand() % 256), static_cast<Uint8>(rand() % 256), static_cast<Uint8>(rand() % 256), 255 };
-    materials.WetColor[(int)AddableMaterials[CurrMaterialIndex]] = Darken_Color(materials.color[(int)AddableMaterials[CurrMaterialIndex]], 25);
-}
-
-void HandleSimulationEvents(SDL_Event& event, Cell(&Grid)[GRID_LENGTH][GRID_WIDTH]) {
-    if (event.type == SDL_KEYDOWN) {
-        switch (event.key.keysym.sym) {
-        case SDLK_BACKSPACE:
-            InitializeGrid(Grid); //Reset grid
-            break;
-
-        case SDLK_s:
-            Switch_Material();
-            break;
-
-        case SDLK_c:
-            Randomize_Color(); //Randomize current color
-            break;
-        }
-    }
-}
-
-void SetBrushSize(int& size) {
-    selection_size = size;
+void SetUpdateThreads(int threads) {
+    UpdatePool.reset(new ThreadPool(std::max(1, threads)));
 }
 
 #pragma endregion
\ No newline at end of file
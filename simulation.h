@@ -4,40 +4,42 @@
 #include <vector>
 #include <algorithm>
 #include <string>
-
-// Third Party
-#include <SDL.h>
-#include <SDL_ttf.h>
+#include <cstdint>
 
 #include "constants.h"
-
-enum class CellState {
-    EMPTY = 0,
-    SAND,
-    ROCK,
-    BEDROCK,
-    WATER,
-    ACID
+#include "grid.h"
+
+//Simulation core, no SDL in here so it also builds into the headless runner.
+//Drawing and SDL input live in view.h.
+
+//Where the brush is this tick, in grid cells
+struct BrushInput {
+    bool Active = false; //Spawn Material around (y, x) this tick
+    int y = 0;
+    int x = 0;
+    int Size = SELECTION_SIZE; //Cells from the center to the edge of the square
+    CellState Material = CellState::SAND;
 };
 
-struct Cell {
-    CellState state; //Cell state, sand, water, etc.
-    uint8_t wetness = 0; //Wetness value, 0 = dry, 100 = fully wet.
-    uint8_t comboTimer = 0; //Combo timers per cell for delays.
-};
+inline bool operator==(const BrushInput& a, const BrushInput& b) {
+    return a.Active == b.Active && a.y == b.y && a.x == b.x && a.Size == b.Size && a.Material == b.Material;
+}
 
-void InitializeSim(Cell Grid[GRID_LENGTH][GRID_WIDTH]);
-void UpdateGrid(Cell(&Grid)[GRID_LENGTH][GRID_WIDTH], bool& LmbHeld);
-void RenderGrid(SDL_Renderer* renderer, Cell(&Grid)[GRID_LENGTH][GRID_WIDTH]);
-void SetBrushSize(int&);
+inline bool operator!=(const BrushInput& a, const BrushInput& b) {
+    return !(a == b);
+}
+
+void InitializeSim(CellGrid& Grid, uint64_t Seed);
+void SeedSimulation(CellGrid& Grid, uint64_t Seed); //Same seed, same run
+void ResetGrid(CellGrid& Grid); //Empty world with a bedrock border (just an empty window when a sparse world is open)
+void UpdateGrid(CellGrid& Grid, const BrushInput& Brush);
+void SetUpdateThreads(int threads); //1 = single threaded update
 
 //UI Function
 void Switch_Material();
 void Switch_Material(int);
-void Set_Curr_Color(SDL_Color Color);
-SDL_Color& Get_Curr_Color();
-
-void HandleSimulationEvents(SDL_Event& event, Cell (&Grid)[GRID_LENGTH][GRID_WIDTH]);
 
+CellState GetCurrentState();
 std::string GetCurrentMaterial();
-std::vector<std::string> GetAddableMaterials();
\ No newline at end of file
+std::vector<std::string> GetAddableMaterials();
+const std::string CellStateToString(CellState state);
@@ -0,0 +1,86 @@
+#include "threadpool.h"
+
+#include "trace.h"
+
+#pragma region Pool Methods
+
+ThreadPool::ThreadPool(int threadCount) {
+    for (int i = 1; i < threadCount; i++) {
+        workers.emplace_back(&ThreadPool::WorkerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+
+    wakeWorkers.notify_all();
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::ParallelFor(int count, const std::function<void(int)>& job) {
+    if (count <= 0) return;
+
+    //Not worth waking anyone for a single job
+    if (workers.empty() || count == 1) {
+        for (int i = 0; i < count; i++) job(i);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        currentJob = &job;
+        jobCount = count;
+        nextJob.store(0, std::memory_order_relaxed);
+        busyWorkers = static_cast<int>(workers.size());
+        batch++;
+    }
+
+    wakeWorkers.notify_all();
+
+    RunJobs();
+
+    //Wait for workers still finishing their last job
+    std::unique_lock<std::mutex> lock(mutex);
+    batchDone.wait(lock, [this] { return busyWorkers == 0; });
+    currentJob = nullptr;
+}
+
+void ThreadPool::RunJobs() {
+    for (;;) {
+        int index = nextJob.fetch_add(1, std::memory_order_relaxed);
+        if (index >= jobCount) return;
+
+        (*currentJob)(index);
+    }
+}
+
+void ThreadPool::WorkerLoop() {
+    SAND_TRACE_THREAD("Update worker");
+
+    uint64_t seenBatch = 0;
+
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeWorkers.wait(lock, [&] { return stopping || batch != seenBatch; });
+
+            if (stopping) return;
+            seenBatch = batch;
+        }
+
+        RunJobs();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--busyWorkers == 0) {
+            batchDone.notify_one();
+        }
+    }
+}
+
+#pragma endregion
@@ -0,0 +1,58 @@
+#pragma once
+// C++ Standard Libraries
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <cstdint>
+
+//Lock for very short critical sections that are almost never contended
+class SpinLock {
+public:
+    void lock() {
+        while (flag.test_and_set(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+    }
+
+    void unlock() { flag.clear(std::memory_order_release); }
+
+private:
+    std::atomic_flag flag = ATOMIC_FLAG_INIT;
+};
+
+//Fixed set of worker threads for splitting one batch of jobs at a time.
+//The calling thread works on the batch too, so a pool of N threads starts N - 1 workers.
+class ThreadPool {
+public:
+    explicit ThreadPool(int threadCount);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int ThreadCount() const { return static_cast<int>(workers.size()) + 1; }
+
+    //Run job(0) ... job(count - 1) across the pool, returns once every job is done
+    void ParallelFor(int count, const std::function<void(int)>& job);
+
+private:
+    void WorkerLoop();
+    void RunJobs();
+
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable wakeWorkers;
+    std::condition_variable batchDone;
+
+    const std::function<void(int)>* currentJob = nullptr;
+    int jobCount = 0;
+    std::atomic<int> nextJob{ 0 };
+
+    int busyWorkers = 0;
+    uint64_t batch = 0; //Bumped for every ParallelFor so workers know there's new work
+    bool stopping = false;
+};
@@ -0,0 +1,145 @@
+#include "trace.h"
+
+#ifdef SANDMAKER_TRACE
+
+// C++ Standard Libraries
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+
+#include "threadpool.h"
+
+#pragma region Buffers
+
+struct TraceEvent {
+    const char* name;
+    uint64_t start;
+    uint64_t end;
+};
+
+//One per thread that ever traced, kept after the thread exits so its events still export
+struct TraceBuffer {
+    std::vector<TraceEvent> events; //Grows up to TRACE_EVENTS_PER_THREAD, then wraps
+    size_t next = 0;
+    int threadId = 0;
+    std::string threadName;
+    SpinLock lock; //Only contended while exporting
+};
+
+std::mutex BuffersLock;
+std::vector<std::unique_ptr<TraceBuffer>> Buffers;
+
+const std::chrono::steady_clock::time_point TraceEpoch = std::chrono::steady_clock::now();
+
+TraceBuffer& ThreadBuffer() {
+    thread_local TraceBuffer* buffer = nullptr;
+
+    if (!buffer) {
+        std::lock_guard<std::mutex> lock(BuffersLock);
+
+        Buffers.emplace_back(new TraceBuffer());
+        buffer = Buffers.back().get();
+        buffer->threadId = static_cast<int>(Buffers.size());
+        buffer->threadName = "Thread " + std::to_string(buffer->threadId);
+    }
+
+    return *buffer;
+}
+
+uint64_t TraceNow() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - TraceEpoch).count());
+}
+
+void SetTraceThreadName(const char* name) {
+    TraceBuffer& buffer = ThreadBuffer();
+
+    std::lock_guard<SpinLock> lock(buffer.lock);
+    buffer.threadName = name;
+}
+
+void RecordTraceEvent(const char* name, uint64_t start, uint64_t end) {
+    TraceBuffer& buffer = ThreadBuffer();
+
+    std::lock_guard<SpinLock> lock(buffer.lock);
+
+    if (buffer.events.size() < static_cast<size_t>(TRACE_EVENTS_PER_THREAD)) {
+        buffer.events.push_back({ name, start, end });
+    }
+
+    else {
+        buffer.events[buffer.next] = { name, start, end };
+        buffer.next = (buffer.next + 1) % buffer.events.size();
+    }
+}
+
+#pragma endregion
+
+#pragma region Export
+
+bool ExportTrace(const std::string& path, std::string& error) {
+    std::ofstream file(path);
+
+    if (!file) {
+        error = "can't open " + path + " for writing";
+        return false;
+    }
+
+    file << std::fixed << std::setprecision(3);
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+    bool first = true;
+    auto Separator = [&file, &first]() {
+        if (!first) file << ",\n";
+        first = false;
+    };
+
+    std::lock_guard<std::mutex> buffersLock(BuffersLock);
+
+    for (const std::unique_ptr<TraceBuffer>& buffer : Buffers) {
+        std::vector<TraceEvent> events;
+        std::string threadName;
+
+        {
+            std::lock_guard<SpinLock> lock(buffer->lock);
+
+            //Oldest first
+            events.assign(buffer->events.begin() + buffer->next, buffer->events.end());
+            events.insert(events.end(), buffer->events.begin(), buffer->events.begin() + buffer->next);
+            threadName = buffer->threadName;
+        }
+
+        Separator();
+        file << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << buffer->threadId
+            << ",\"args\":{\"name\":\"" << threadName << "\"}}";
+
+        //Complete events, timestamps in microseconds
+        for (const TraceEvent& event : events) {
+            Separator();
+            file << "{\"ph\":\"X\",\"name\":\"" << event.name << "\",\"pid\":1,\"tid\":" << buffer->threadId
+                << ",\"ts\":" << event.start / 1000.0 << ",\"dur\":" << (event.end - event.start) / 1000.0 << "}";
+        }
+    }
+
+    file << "\n]}\n";
+
+    if (!file) {
+        error = "write to " + path + " failed";
+        return false;
+    }
+
+    return true;
+}
+
+#pragma endregion
+
+#else
+
+bool ExportTrace(const std::string&, std::string& error) {
+    error = "tracing isn't built in (define SANDMAKER_TRACE)";
+    return false;
+}
+
+#endif
@@ -0,0 +1,47 @@
+#pragma once
+// C++ Standard Libraries
+#include <string>
+#include <cstdint>
+
+//Timeline tracing. SAND_TRACE_SCOPE("Name") records when its scope started and ended into a
+//ring buffer owned by the calling thread, ExportTrace writes every thread's buffer out as
+//Chrome trace event JSON (open in chrome://tracing or ui.perfetto.dev) to see how ticks, chunk
+//jobs, uploads and UI renders line up across threads.
+//Only built in with SANDMAKER_TRACE defined, otherwise the macros compile to nothing.
+
+const int TRACE_EVENTS_PER_THREAD = 1 << 16; //Oldest events are overwritten past this
+
+//Write the recorded events, false (with error set) if tracing isn't built in
+bool ExportTrace(const std::string& path, std::string& error);
+
+#ifdef SANDMAKER_TRACE
+
+void SetTraceThreadName(const char* name);
+uint64_t TraceNow(); //Nanoseconds since startup
+void RecordTraceEvent(const char* name, uint64_t start, uint64_t end);
+
+class TraceScope {
+public:
+    explicit TraceScope(const char* name) : name(name), start(TraceNow()) {}
+    ~TraceScope() { RecordTraceEvent(name, start, TraceNow()); }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* name; //Must outlive the trace, string literals only
+    uint64_t start;
+};
+
+#define SAND_TRACE_CONCAT_INNER(a, b) a##b
+#define SAND_TRACE_CONCAT(a, b) SAND_TRACE_CONCAT_INNER(a, b)
+
+#define SAND_TRACE_SCOPE(name) TraceScope SAND_TRACE_CONCAT(traceScope, __LINE__)(name)
+#define SAND_TRACE_THREAD(name) SetTraceThreadName(name)
+
+#else
+
+#define SAND_TRACE_SCOPE(name) ((void)0)
+#define SAND_TRACE_THREAD(name) ((void)0)
+
+#endif
@@ -0,0 +1,279 @@
+// C++ Standard Libraries
+#include <cstdlib>
+#include <vector>
+#include <atomic>
+
+#include "view.h"
+#include "kernels.h"
+#include "trace.h"
+#include "world.h"
+
+#pragma region Script Variables
+SDL_Color MaterialColors[NUM_MATERIALS]; //Dry color of particle
+SDL_Color WetColors[NUM_MATERIALS]; //Wet color of the particle
+
+SDL_Texture* GridTexture = nullptr; //One pixel per cell
+SDL_Renderer* GridTextureRenderer = nullptr;
+int GridTextureLength = 0;
+int GridTextureWidth = 0;
+bool GridTextureFresh = false; //Just created, nothing uploaded yet
+
+std::vector<Uint32> GridPixels; //CPU copy of the texture, dirty rects are uploaded from here
+std::atomic<bool> ColorsChanged{ false }; //Palette needs rebuilding and every cell redrawing (set from the color picker thread too)
+
+Uint32 Palette[NUM_MATERIALS * PALETTE_WETNESS_LEVELS]; //Packed pixel per (material, wetness)
+
+const char* const QUICKSAVE_PATH = "world.sand"; //F5 saves here, F9 loads it
+#pragma endregion
+
+#pragma region Initializations
+
+void InitializeColors() {
+    //Initialize Colors
+    MaterialColors[static_cast<int>(CellState::EMPTY)] = { 13, 13, 13, 255 };
+    MaterialColors[static_cast<int>(CellState::SAND)] = { 226, 202, 118, 128 };
+    MaterialColors[static_cast<int>(CellState::ROCK)] = { 33, 33, 33, 255 };
+    MaterialColors[(int)CellState::BEDROCK] = { 10, 10, 10, 255 };
+
+    MaterialColors[static_cast<int>(CellState::WATER)] = { 0, 84, 119, 255 };
+    MaterialColors[static_cast<int>(CellState::ACID)] = { 176, 191, 26, 255 };
+
+    //Initialize Wet Colors
+    WetColors[static_cast<int>(CellState::EMPTY)] = { 13, 13, 13, 255 };
+    WetColors[static_cast<int>(CellState::SAND)] = { 145, 129, 73, 255 };
+    WetColors[static_cast<int>(CellState::ROCK)] = { 15, 15, 15, 255 };
+    WetColors[(int)CellState::BEDROCK] = { 10, 10, 10, 255 };
+
+    WetColors[static_cast<int>(CellState::WATER)] = { 0, 84, 119, 255 };
+    WetColors[static_cast<int>(CellState::ACID)] = { 176, 191, 26, 255 };
+
+    ColorsChanged = true;
+}
+
+#pragma endregion
+
+#pragma region Colors
+
+SDL_Color LerpColor(const SDL_Color& a, const SDL_Color& b, float t) { //where t is the wetness/100
+    SDL_Color result;
+
+    result.r = a.r + (b.r - a.r) * t;
+    result.g = a.g + (b.g - a.g) * t;
+    result.b = a.b + (b.b - a.b) * t;
+    result.a = a.a + (b.a - a.a) * t;;
+
+    return result;
+}
+
+SDL_Color Darken_Color(SDL_Color Color, Uint8 DarknessFac) {
+    return {
+        static_cast<Uint8>(std::max(0, Color.r - DarknessFac)),
+        static_cast<Uint8>(std::max(0, Color.g - DarknessFac)),
+        static_cast<Uint8>(std::max(0, Color.b - DarknessFac)),
+        Color.a
+    };
+}
+
+void Set_Curr_Color(SDL_Color Color) {
+    MaterialColors[(int)GetCurrentState()] = Color;
+    WetColors[(int)GetCurrentState()] = Darken_Color(Color, 30);
+    ColorsChanged = true;
+}
+
+SDL_Color& Get_Curr_Color() {
+    return MaterialColors[(int)GetCurrentState()];
+}
+
+// Colored sand
+
+void Randomize_Color() {
+    MaterialColors[(int)GetCurrentState()] = { static_cast<Uint8>(rand() % 256), static_cast<Uint8>(rand() % 256), static_cast<Uint8>(rand() % 256), 255 };
+    WetColors[(int)GetCurrentState()] = Darken_Color(MaterialColors[(int)GetCurrentState()], 25);
+    ColorsChanged = true;
+}
+
+#pragma endregion
+
+#pragma region Grid Drawers
+
+//Packed pixel for the texture format (SDL_PIXELFORMAT_ARGB8888)
+Uint32 PackColor(const SDL_Color& color) {
+    return (static_cast<Uint32>(color.a) << 24) | (static_cast<Uint32>(color.r) << 16) | (static_cast<Uint32>(color.g) << 8) | color.b;
+}
+
+//Pixel of every (material, wetness) pair, drawing a cell is then just a lookup
+void RebuildPalette() {
+    for (int material = 0; material < NUM_MATERIALS; material++) {
+        Uint32* entries = Palette + material * PALETTE_WETNESS_LEVELS;
+
+        for (int wetness = 0; wetness < PALETTE_WETNESS_LEVELS; wetness++) {
+            if (material != static_cast<int>(CellState::EMPTY)) {
+                float wetFactor = std::max(0.0f, std::min(wetness / 100.0f, 1.0f));
+                entries[wetness] = PackColor(LerpColor(MaterialColors[material], WetColors[material], wetFactor));
+            }
+
+            else {
+                entries[wetness] = PackColor(MaterialColors[material]);
+            }
+        }
+    }
+}
+
+//Grid sized texture, recreated when the renderer or grid size changes
+SDL_Texture* GetGridTexture(SDL_Renderer* renderer, int Length, int Width) {
+    if (GridTexture && GridTextureRenderer == renderer && GridTextureLength == Length && GridTextureWidth == Width) {
+        return GridTexture;
+    }
+
+    ReleaseGridTexture();
+
+    GridTexture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, Width, Length);
+    if (!GridTexture) return nullptr;
+
+    //Cells are blown up to CELL_SIZE squares, and written over the background like the old fill rects
+    SDL_SetTextureScaleMode(GridTexture, SDL_ScaleModeNearest);
+    SDL_SetTextureBlendMode(GridTexture, SDL_BLENDMODE_NONE);
+
+    GridTextureRenderer = renderer;
+    GridTextureLength = Length;
+    GridTextureWidth = Width;
+    GridTextureFresh = true;
+
+    GridPixels.assign(static_cast<size_t>(Length) * Width, 0);
+
+    return GridTexture;
+}
+
+void ReleaseGridTexture() {
+    if (GridTexture) SDL_DestroyTexture(GridTexture);
+
+    GridTexture = nullptr;
+    GridTextureRenderer = nullptr;
+}
+
+void InvalidateGridTexture() {
+    ColorsChanged = true;
+}
+
+//Redraw the dirty cells and upload only their bounding box. Works on anything with plane rows,
+//the live grid or a snapshot of it.
+template <typename Planes>
+bool UploadCells(SDL_Renderer* renderer, const Planes& Grid, DirtyRect dirty) {
+    SAND_TRACE_SCOPE("UploadCells");
+
+    SDL_Texture* texture = GetGridTexture(renderer, Grid.Length(), Grid.Width());
+    if (!texture) return false;
+
+    if (ColorsChanged.exchange(false)) {
+        RebuildPalette();
+        GridTextureFresh = true;
+    }
+
+    if (GridTextureFresh) {
+        dirty.Include(0, 0, Grid.Width() - 1, Grid.Length() - 1);
+        GridTextureFresh = false;
+    }
+
+    if (dirty.Empty()) return false;
+
+    int Width = Grid.Width();
+
+    int Span = dirty.maxX - dirty.minX + 1;
+
+    for (int row = dirty.minY; row <= dirty.maxY; ++row) {
+        Uint32* dst = GridPixels.data() + static_cast<size_t>(row) * Width + dirty.minX;
+        GatherPalette(Grid.WordRow(row) + dirty.minX, Palette, dst, Span);
+    }
+
+    SDL_Rect dirtyRect{ dirty.minX, dirty.minY, dirty.maxX - dirty.minX + 1, dirty.maxY - dirty.minY + 1 };
+    const Uint32* src = GridPixels.data() + static_cast<size_t>(dirty.minY) * Width + dirty.minX;
+
+    SDL_UpdateTexture(texture, &dirtyRect, src, Width * static_cast<int>(sizeof(Uint32)));
+    return true;
+}
+
+bool UpdateGridTexture(SDL_Renderer* renderer, CellGrid& Grid) {
+    return UploadCells(renderer, Grid, Grid.TakeRenderDirty());
+}
+
+bool UpdateGridTexture(SDL_Renderer* renderer, const GridSnapshot& Snapshot) {
+    return UploadCells(renderer, Snapshot, Snapshot.dirty);
+}
+
+//Clear and draw the grid texture, blown up to CELL_SIZE squares
+void DrawGrid(SDL_Renderer* renderer) {
+    SAND_TRACE_SCOPE("DrawGrid");
+
+    SDL_RenderClear(renderer);
+
+    if (!GridTexture) return;
+
+    SDL_Rect gridRect{ 0, 0, GridTextureWidth * CELL_SIZE, GridTextureLength * CELL_SIZE };
+    SDL_RenderCopy(renderer, GridTexture, nullptr, &gridRect);
+}
+
+//Render Grid
+void RenderGrid(SDL_Renderer* renderer, CellGrid& Grid) {
+    SAND_TRACE_SCOPE("RenderGrid");
+
+    UpdateGridTexture(renderer, Grid);
+    DrawGrid(renderer);
+}
+
+#pragma endregion
+
+#pragma region Key Actions
+
+BrushInput GetMouseBrush(bool LmbHeld, int Size) {
+    BrushInput Brush;
+
+    int MouseX, MouseY;
+    SDL_GetMouseState(&MouseX, &MouseY);
+
+    Brush.Active = LmbHeld;
+    Brush.x = MouseX / CELL_SIZE;
+    Brush.y = MouseY / CELL_SIZE;
+    Brush.Size = Size;
+    Brush.Material = GetCurrentState();
+
+    return Brush;
+}
+
+void HandleSimulationEvents(SDL_Event& event, SimulationThread& Sim) {
+    if (event.type == SDL_KEYDOWN) {
+        switch (event.key.keysym.sym) {
+        case SDLK_BACKSPACE:
+            Sim.Reset(); //Reset grid
+            break;
+
+        case SDLK_s:
+            Switch_Material();
+            break;
+
+        case SDLK_c:
+            Randomize_Color(); //Randomize current color
+            break;
+
+        case SDLK_F5:
+            Sim.Save(QUICKSAVE_PATH);
+            break;
+
+        case SDLK_F9:
+            Sim.Load(QUICKSAVE_PATH);
+            break;
+
+        //Move the window around a sparse world, a chunk at a time
+        case SDLK_UP:
+        case SDLK_DOWN:
+        case SDLK_LEFT:
+        case SDLK_RIGHT:
+            if (WorldOpen()) {
+                SDL_Keycode key = event.key.keysym.sym;
+                Sim.Pan((key == SDLK_DOWN) - (key == SDLK_UP), (key == SDLK_RIGHT) - (key == SDLK_LEFT));
+            }
+            break;
+        }
+    }
+}
+
+#pragma endregion
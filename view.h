@@ -0,0 +1,33 @@
+#pragma once
+// C++ Standard Libraries
+#include <algorithm>
+
+// Third Party
+#include <SDL.h>
+#include <SDL_ttf.h>
+
+#include "constants.h"
+#include "grid.h"
+#include "simulation.h"
+#include "simthread.h"
+
+//SDL side of the simulation: material colors, drawing the grid and turning input into sim calls
+
+void InitializeColors();
+void RenderGrid(SDL_Renderer* renderer, CellGrid& Grid); //UpdateGridTexture + DrawGrid
+
+//Upload the cells that changed since the last call to the grid texture, false if none did
+bool UpdateGridTexture(SDL_Renderer* renderer, CellGrid& Grid);
+bool UpdateGridTexture(SDL_Renderer* renderer, const GridSnapshot& Snapshot); //Snapshot's dirty rect
+void DrawGrid(SDL_Renderer* renderer);
+void InvalidateGridTexture(); //Upload every cell on the next update
+void ReleaseGridTexture(); //Call before destroying the renderer RenderGrid draws with
+
+//Brush under the mouse with the current material, active while the left button is held
+BrushInput GetMouseBrush(bool LmbHeld, int Size);
+
+void HandleSimulationEvents(SDL_Event& event, SimulationThread& Sim);
+
+//UI Function
+void Set_Curr_Color(SDL_Color Color);
+SDL_Color& Get_Curr_Color();
@@ -0,0 +1,374 @@
+#include "world.h"
+
+// C++ Standard Libraries
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <filesystem>
+#include <algorithm>
+#include <cstdio>
+
+#pragma region Script Variables
+
+const int CHUNK_CELLS = CHUNK_SIZE * CHUNK_SIZE;
+
+//Cells of one world chunk. A chunk that's all one value (a slab of rock, the middle of a lake) is
+//just that value, the cell array is only allocated once a write breaks it up.
+struct StoredChunk {
+    Cell fill = Cell{ CellState::EMPTY }; //Every cell, while cells is null
+    std::unique_ptr<Cell[]> cells; //Row major
+
+    bool Uniform() const { return !cells; }
+    Cell At(int i) const { return cells ? cells[i] : fill; }
+
+    void Write(int i, const Cell& cell) {
+        if (!cells) {
+            if (cell == fill) return;
+
+            cells.reset(new Cell[CHUNK_CELLS]);
+            std::fill(cells.get(), cells.get() + CHUNK_CELLS, fill);
+        }
+
+        cells[i] = cell;
+    }
+
+    //Back to a single value if every cell ended up the same
+    void Collapse() {
+        if (!cells) return;
+
+        for (int i = 1; i < CHUNK_CELLS; i++) {
+            if (cells[i] != cells[0]) return;
+        }
+
+        fill = cells[0];
+        cells.reset();
+    }
+};
+
+const char CHUNK_MAGIC[4] = { 'S', 'N', 'D', 'C' };
+const size_t CHUNK_HEADER_SIZE = 10;
+
+bool IsOpen = false;
+std::filesystem::path WorldDir;
+
+int OriginX = 0; //World chunk under window chunk (0, 0)
+int OriginY = 0;
+
+std::unordered_map<uint64_t, std::unique_ptr<StoredChunk>> StoredChunks; //Populated chunks in memory
+std::unordered_set<uint64_t> DiskChunks; //Chunks with a file in WorldDir
+
+#pragma endregion
+
+#pragma region Helper Functions
+
+uint64_t ChunkKey(int x, int y) {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(y)) << 32) | static_cast<uint32_t>(x);
+}
+
+int KeyX(uint64_t key) { return static_cast<int32_t>(static_cast<uint32_t>(key)); }
+int KeyY(uint64_t key) { return static_cast<int32_t>(static_cast<uint32_t>(key >> 32)); }
+
+std::filesystem::path ChunkPath(int x, int y) {
+    return WorldDir / (std::to_string(x) + "_" + std::to_string(y) + ".chunk");
+}
+
+//Nothing in it to update, a wake that reaches it from a neighbor is enough
+bool IsInert(const Cell& cell) {
+    return !CanUpdate(cell.state) && cell.wetness == 0 && cell.comboTimer == 0;
+}
+
+bool WriteChunk(int x, int y, const StoredChunk& chunk, std::string& error) {
+    std::vector<uint8_t> out(CHUNK_MAGIC, CHUNK_MAGIC + 4);
+    out.reserve(CHUNK_HEADER_SIZE + CHUNK_CELLS * 4);
+
+    for (int i = 0; i < 4; i++) {
+        out.push_back(static_cast<uint8_t>(CHUNK_FILE_VERSION >> (8 * i)));
+    }
+
+    out.push_back(NUM_MATERIALS);
+    out.push_back(chunk.Uniform());
+
+    for (int i = 0; i < (chunk.Uniform() ? 1 : CHUNK_CELLS); i++) {
+        Cell cell = chunk.At(i);
+
+        out.push_back(static_cast<uint8_t>(cell.state));
+        out.push_back(cell.wetness);
+        out.push_back(cell.comboTimer);
+        out.push_back(cell.velocity);
+    }
+
+    std::filesystem::path path = ChunkPath(x, y);
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(out.data()), static_cast<std::streamsize>(out.size()));
+
+    if (!file) {
+        error = "write to " + path.string() + " failed";
+        return false;
+    }
+
+    return true;
+}
+
+bool ReadChunk(int x, int y, StoredChunk& chunk, std::string& error) {
+    std::filesystem::path path = ChunkPath(x, y);
+    std::ifstream file(path, std::ios::binary);
+    std::vector<uint8_t> in((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    uint32_t version = 0;
+    if (in.size() >= 8) {
+        for (int i = 0; i < 4; i++) version |= static_cast<uint32_t>(in[4 + i]) << (8 * i);
+    }
+
+    size_t headerSize = version >= 2 ? CHUNK_HEADER_SIZE : CHUNK_HEADER_SIZE - 1; //Version 1 has no uniform byte
+    bool uniform = version >= 2 && in.size() >= headerSize && in[9] != 0;
+    int count = uniform ? 1 : CHUNK_CELLS;
+    int cellSize = version >= 3 ? 4 : 3; //Versions 1 and 2 have no velocity
+
+    if (in.size() != headerSize + static_cast<size_t>(count) * cellSize || !std::equal(CHUNK_MAGIC, CHUNK_MAGIC + 4, in.begin()) ||
+        version < 1 || version > CHUNK_FILE_VERSION || in[8] != NUM_MATERIALS) {
+        error = path.string() + " is not a chunk this build can read";
+        return false;
+    }
+
+    const uint8_t* cell = in.data() + headerSize;
+
+    for (int i = 0; i < count; i++) {
+        uint8_t velocity = cellSize == 4 ? cell[3] : 0;
+
+        if (cell[0] >= NUM_MATERIALS || cell[1] > MAX_WETNESS || velocity > MAX_VELOCITY) {
+            error = path.string() + " has a bad cell";
+            return false;
+        }
+
+        Cell value{ static_cast<CellState>(cell[0]), cell[1], cell[2], velocity };
+
+        if (uniform) chunk.fill = value;
+        else chunk.Write(i, value);
+
+        cell += cellSize;
+    }
+
+    chunk.Collapse();
+    return true;
+}
+
+//Stored chunk at world chunk (x, y), paged in from disk if it was evicted. nullptr for empty chunks.
+StoredChunk* FindChunk(int x, int y) {
+    uint64_t key = ChunkKey(x, y);
+
+    auto found = StoredChunks.find(key);
+    if (found != StoredChunks.end()) return found->second.get();
+
+    if (!DiskChunks.count(key)) return nullptr;
+
+    std::unique_ptr<StoredChunk> chunk(new StoredChunk());
+    std::string error;
+
+    if (!ReadChunk(x, y, *chunk, error)) {
+        std::cout << "World: " << error << ", treating it as empty\n";
+        DiskChunks.erase(key);
+        return nullptr;
+    }
+
+    return (StoredChunks[key] = std::move(chunk)).get();
+}
+
+//The chunk went empty, forget it in memory and on disk
+void DropChunk(int x, int y) {
+    uint64_t key = ChunkKey(x, y);
+
+    StoredChunks.erase(key);
+
+    if (DiskChunks.erase(key)) {
+        std::error_code ec;
+        std::filesystem::remove(ChunkPath(x, y), ec);
+    }
+}
+
+//Part of window chunk (cy, cx) that's inside the grid, in grid cells
+void WindowChunkRect(const CellGrid& Grid, int cy, int cx, int& y0, int& x0, int& y1, int& x1) {
+    y0 = cy * CHUNK_SIZE;
+    x0 = cx * CHUNK_SIZE;
+    y1 = std::min(y0 + CHUNK_SIZE, Grid.Length()) - 1;
+    x1 = std::min(x0 + CHUNK_SIZE, Grid.Width()) - 1;
+}
+
+//Copy the window into the store. Chunks the grid edge cuts through keep the part outside it.
+void StashWindow(const CellGrid& Grid) {
+    for (int cy = 0; cy < Grid.ChunksY(); cy++) {
+        for (int cx = 0; cx < Grid.ChunksX(); cx++) {
+            int wx = OriginX + cx;
+            int wy = OriginY + cy;
+
+            StoredChunk* stored = FindChunk(wx, wy);
+            if (!stored) stored = (StoredChunks[ChunkKey(wx, wy)] = std::unique_ptr<StoredChunk>(new StoredChunk())).get();
+
+            int y0, x0, y1, x1;
+            WindowChunkRect(Grid, cy, cx, y0, x0, y1, x1);
+
+            for (int y = y0; y <= y1; y++) {
+                for (int x = x0; x <= x1; x++) {
+                    stored->Write((y - y0) * CHUNK_SIZE + (x - x0), Grid.Get(y, x));
+                }
+            }
+
+            stored->Collapse();
+
+            if (stored->Uniform() && stored->fill == Cell{ CellState::EMPTY }) DropChunk(wx, wy);
+        }
+    }
+}
+
+//Copy the store into the window, chunks that aren't stored are empty. Uniform chunks of
+//something that never updates (air, most of the time) aren't woken, only their edges are, by
+//the chunks next to them.
+void FillWindow(CellGrid& Grid) {
+    Grid.ClearWake();
+
+    for (int cy = 0; cy < Grid.ChunksY(); cy++) {
+        for (int cx = 0; cx < Grid.ChunksX(); cx++) {
+            const StoredChunk* stored = FindChunk(OriginX + cx, OriginY + cy);
+
+            int y0, x0, y1, x1;
+            WindowChunkRect(Grid, cy, cx, y0, x0, y1, x1);
+
+            if (!stored || stored->Uniform()) {
+                Cell fill = stored ? stored->fill : Cell{ CellState::EMPTY };
+
+                for (int y = y0; y <= y1; y++) {
+                    for (int x = x0; x <= x1; x++) {
+                        Grid.Set(y, x, fill);
+                    }
+                }
+
+                if (IsInert(fill)) continue;
+            }
+
+            else {
+                for (int y = y0; y <= y1; y++) {
+                    for (int x = x0; x <= x1; x++) {
+                        Grid.Set(y, x, stored->At((y - y0) * CHUNK_SIZE + (x - x0)));
+                    }
+                }
+            }
+
+            Grid.WakeRect(y0 - 1, x0 - 1, y1 + 1, x1 + 1);
+        }
+    }
+}
+
+//Write the chunks far from the window to disk and free them
+void EvictFarChunks(const CellGrid& Grid) {
+    int maxX = OriginX + Grid.ChunksX() - 1;
+    int maxY = OriginY + Grid.ChunksY() - 1;
+
+    for (auto it = StoredChunks.begin(); it != StoredChunks.end();) {
+        int x = KeyX(it->first);
+        int y = KeyY(it->first);
+
+        int distance = std::max({ OriginX - x, x - maxX, OriginY - y, y - maxY });
+
+        if (distance <= WORLD_MEMORY_RADIUS) {
+            ++it;
+            continue;
+        }
+
+        std::string error;
+
+        if (!WriteChunk(x, y, *it->second, error)) {
+            std::cout << "World: " << error << ", keeping the chunk in memory\n";
+            ++it;
+            continue;
+        }
+
+        DiskChunks.insert(it->first);
+        it = StoredChunks.erase(it);
+    }
+}
+
+#pragma endregion
+
+#pragma region World
+
+bool OpenWorld(CellGrid& Grid, const std::string& dir, std::string& error) {
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+
+    if (!std::filesystem::is_directory(dir, ec)) {
+        error = "can't use " + dir + " as a world directory";
+        return false;
+    }
+
+    IsOpen = true;
+    WorldDir = dir;
+    OriginX = 0;
+    OriginY = 0;
+    StoredChunks.clear();
+    DiskChunks.clear();
+
+    //Index the chunks already on disk, they're read when the window reaches them
+    for (const auto& entry : std::filesystem::directory_iterator(WorldDir, ec)) {
+        if (entry.path().extension() != ".chunk") continue;
+
+        int x = 0, y = 0;
+        char extra = 0;
+
+        if (std::sscanf(entry.path().stem().string().c_str(), "%d_%d%c", &x, &y, &extra) == 2) {
+            DiskChunks.insert(ChunkKey(x, y));
+        }
+    }
+
+    FillWindow(Grid);
+    return true;
+}
+
+bool WorldOpen() {
+    return IsOpen;
+}
+
+void PanWorld(CellGrid& Grid, int dy, int dx) {
+    if (!IsOpen || (dy == 0 && dx == 0)) return;
+
+    StashWindow(Grid);
+
+    OriginX += dx;
+    OriginY += dy;
+
+    FillWindow(Grid);
+    EvictFarChunks(Grid);
+}
+
+bool FlushWorld(CellGrid& Grid, std::string& error) {
+    if (!IsOpen) return true;
+
+    StashWindow(Grid);
+
+    for (const auto& stored : StoredChunks) {
+        if (!WriteChunk(KeyX(stored.first), KeyY(stored.first), *stored.second, error)) return false;
+
+        DiskChunks.insert(stored.first);
+    }
+
+    return true;
+}
+
+WorldStats GetWorldStats() {
+    WorldStats stats;
+    stats.originX = OriginX;
+    stats.originY = OriginY;
+    stats.chunksInMemory = StoredChunks.size();
+
+    for (const auto& stored : StoredChunks) {
+        stats.uniformInMemory += stored.second->Uniform();
+    }
+
+    stats.chunksOnDisk = DiskChunks.size();
+
+    return stats;
+}
+
+#pragma endregion
@@ -0,0 +1,50 @@
+#pragma once
+// C++ Standard Libraries
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+#include "grid.h"
+
+//Sparse unbounded world. The CellGrid becomes a window onto it: only the window is simulated,
+//everything else is kept as CHUNK_SIZE chunks in a hash map keyed by world chunk coordinate.
+//Chunks that are all empty aren't stored at all, and chunks that are all one other value are
+//stored as just that value, so memory follows the detailed area rather than the bounding box.
+//Stored chunks that end up further than WORLD_MEMORY_RADIUS chunks from the window are written
+//to the world directory and paged back in when the window reaches them.
+//
+//The window has no bedrock border. Its outermost ring of cells isn't updated (the same as the
+//border of a bounded grid), so particles that reach the edge wait there until the window moves.
+//Chunk generators stay with their place in the window, which keeps a run deterministic.
+//
+//Chunk file <x>_<y>.chunk (little endian):
+//  "SNDC", u32 version, u8 material count, u8 uniform
+//  uniform: one cell (u8 state, u8 wetness, u8 combo timer, u8 velocity) for the whole chunk
+//  otherwise: every cell, row major
+//Version 2 cells have no velocity byte. Version 1 has no uniform byte either, every cell is stored.
+
+const uint32_t CHUNK_FILE_VERSION = 3;
+const int WORLD_MEMORY_RADIUS = 8; //Chunks kept in memory around the window, past this they go to disk
+
+struct WorldStats {
+    int originX = 0; //World chunk under the window's top left chunk
+    int originY = 0;
+    size_t chunksInMemory = 0; //Populated chunks held in the map, the window's own included
+    size_t uniformInMemory = 0; //How many of those are a single value
+    size_t chunksOnDisk = 0;
+};
+
+//Make Grid a window onto the world in dir (created if it doesn't exist), starting at chunk 0, 0.
+//Replaces every cell of the grid with what the world has there.
+bool OpenWorld(CellGrid& Grid, const std::string& dir, std::string& error);
+bool WorldOpen();
+
+//Move the window by whole chunks: store what it shows, load what it moves onto, and write the
+//chunks it left far behind to disk. Every cell in the window is woken.
+void PanWorld(CellGrid& Grid, int dy, int dx);
+
+//Write the window and every stored chunk to disk, the world can be opened again from there
+bool FlushWorld(CellGrid& Grid, std::string& error);
+
+//Sim thread only (or while it's stopped), like the calls above
+WorldStats GetWorldStats();
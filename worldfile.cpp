@@ -0,0 +1,307 @@
+#include "worldfile.h"
+
+// C++ Standard Libraries
+#include <vector>
+#include <fstream>
+#include <cstring>
+
+#include "simulation.h"
+#include "mappedfile.h"
+
+#pragma region Helper Functions
+
+const char WORLD_MAGIC[4] = { 'S', 'N', 'D', 'W' };
+const int MAX_RUN = 0xFFFF; //Longest run a u16 count holds
+const uint8_t WETNESS_QUEUED = 0x80; //Set in a run's wetness byte when its cells are on a worklist
+
+void Put(std::vector<uint8_t>& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+//Bounds checked little endian reads, ok goes false (and stays false) on reading past the end
+struct ByteReader {
+    const uint8_t* pos;
+    const uint8_t* end;
+    bool ok = true;
+
+    uint64_t Read(int bytes) {
+        if (!ok || end - pos < bytes) {
+            ok = false;
+            return 0;
+        }
+
+        uint64_t value = 0;
+        for (int i = 0; i < bytes; i++) {
+            value |= static_cast<uint64_t>(pos[i]) << (8 * i);
+        }
+
+        pos += bytes;
+        return value;
+    }
+
+    std::string ReadString(int bytes) {
+        if (!ok || end - pos < bytes) {
+            ok = false;
+            return "";
+        }
+
+        std::string text(reinterpret_cast<const char*>(pos), bytes);
+        pos += bytes;
+        return text;
+    }
+};
+
+//Magic, version and size, shared by ReadWorldSize and LoadWorld
+bool ReadHeader(ByteReader& reader, uint32_t& version, int& length, int& width, std::string& error) {
+    if (reader.ReadString(4) != std::string(WORLD_MAGIC, 4)) {
+        error = "not a world file";
+        return false;
+    }
+
+    version = static_cast<uint32_t>(reader.Read(4));
+    if (reader.ok && (version == 0 || version > WORLD_FILE_VERSION)) {
+        error = "unsupported world file version " + std::to_string(version);
+        return false;
+    }
+
+    length = static_cast<int32_t>(reader.Read(4));
+    width = static_cast<int32_t>(reader.Read(4));
+
+    if (!reader.ok || length < 3 || width < 3) {
+        error = "bad world size";
+        return false;
+    }
+
+    return true;
+}
+
+#pragma endregion
+
+#pragma region Saving
+
+bool SaveWorld(const std::string& path, const CellGrid& Grid, std::string& error) {
+    std::vector<uint8_t> out;
+    out.insert(out.end(), WORLD_MAGIC, WORLD_MAGIC + 4);
+
+    Put(out, WORLD_FILE_VERSION, 4);
+    Put(out, static_cast<uint32_t>(Grid.Length()), 4);
+    Put(out, static_cast<uint32_t>(Grid.Width()), 4);
+
+    //Material names
+    Put(out, NUM_MATERIALS, 1);
+
+    for (int i = 0; i < NUM_MATERIALS; i++) {
+        std::string name = CellStateToString(static_cast<CellState>(i));
+
+        Put(out, name.size(), 1);
+        out.insert(out.end(), name.begin(), name.end());
+    }
+
+    //Chunk generators and next tick's rects
+    int chunkCount = Grid.ChunksX() * Grid.ChunksY();
+    Put(out, static_cast<uint32_t>(chunkCount), 4);
+
+    for (int i = 0; i < chunkCount; i++) {
+        const Chunk& chunk = Grid.GetChunk(i);
+        DirtyRect rect = chunk.nextRect.Peek();
+
+        Put(out, chunk.rng.state, 8);
+        Put(out, chunk.rng.increment, 8);
+
+        Put(out, static_cast<uint32_t>(rect.minX), 4);
+        Put(out, static_cast<uint32_t>(rect.minY), 4);
+        Put(out, static_cast<uint32_t>(rect.maxX), 4);
+        Put(out, static_cast<uint32_t>(rect.maxY), 4);
+    }
+
+    //Cells, one row at a time
+    for (int y = 0; y < Grid.Length(); y++) {
+        int x = 0;
+
+        while (x < Grid.Width()) {
+            Cell cell = Grid.Get(y, x);
+            bool queued = Grid.Queued(y, x);
+
+            int run = 1;
+            while (x + run < Grid.Width() && run < MAX_RUN && Grid.Get(y, x + run) == cell && Grid.Queued(y, x + run) == queued) run++;
+
+            Put(out, static_cast<uint16_t>(run), 2);
+            Put(out, static_cast<uint8_t>(cell.state), 1);
+            Put(out, cell.wetness | (queued ? WETNESS_QUEUED : 0), 1);
+            Put(out, cell.comboTimer, 1);
+            Put(out, cell.velocity, 1);
+
+            x += run;
+        }
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(out.data()), static_cast<std::streamsize>(out.size()));
+
+    if (!file) {
+        error = "couldn't write " + path;
+        return false;
+    }
+
+    return true;
+}
+
+#pragma endregion
+
+#pragma region Loading
+
+bool ReadWorldSize(const std::string& path, int& length, int& width, std::string& error) {
+    MappedFile file;
+
+    if (!file.Open(path)) {
+        error = "couldn't open " + path;
+        return false;
+    }
+
+    ByteReader reader{ file.Data(), file.Data() + file.Size() };
+    uint32_t version;
+    return ReadHeader(reader, version, length, width, error);
+}
+
+//Decode the rows, only checking them unless write is set
+bool ReadRows(ByteReader reader, CellGrid& Grid, uint32_t version, const CellState* remap, int materialCount, bool write) {
+    for (int y = 0; y < Grid.Length(); y++) {
+        int x = 0;
+
+        while (x < Grid.Width()) {
+            int run = static_cast<int>(reader.Read(2));
+            int state = static_cast<int>(reader.Read(1));
+
+            Cell cell;
+            cell.wetness = static_cast<uint8_t>(reader.Read(1));
+            cell.comboTimer = static_cast<uint8_t>(reader.Read(1));
+            if (version >= 2) cell.velocity = static_cast<uint8_t>(reader.Read(1));
+
+            bool queued = version >= 3 && (cell.wetness & WETNESS_QUEUED);
+            if (version >= 3) cell.wetness &= ~WETNESS_QUEUED;
+
+            if (!reader.ok || run == 0 || run > Grid.Width() - x || state >= materialCount || cell.wetness > MAX_WETNESS ||
+                cell.velocity > MAX_VELOCITY) return false;
+
+            if (write) {
+                cell.state = remap[state];
+
+                for (int i = 0; i < run; i++) {
+                    Grid.Set(y, x + i, cell);
+                    if (queued) Grid.RestoreQueued(y, x + i);
+                }
+            }
+
+            x += run;
+        }
+    }
+
+    return true;
+}
+
+bool LoadWorld(const std::string& path, CellGrid& Grid, std::string& error) {
+    MappedFile file;
+
+    if (!file.Open(path)) {
+        error = "couldn't open " + path;
+        return false;
+    }
+
+    ByteReader reader{ file.Data(), file.Data() + file.Size() };
+
+    uint32_t version;
+    int length, width;
+    if (!ReadHeader(reader, version, length, width, error)) return false;
+
+    if (length != Grid.Length() || width != Grid.Width()) {
+        error = "world is " + std::to_string(length) + "x" + std::to_string(width) + ", grid is " +
+            std::to_string(Grid.Length()) + "x" + std::to_string(Grid.Width());
+        return false;
+    }
+
+    //File material index -> our CellState, by name
+    int materialCount = static_cast<int>(reader.Read(1));
+    std::vector<CellState> remap;
+
+    for (int i = 0; i < materialCount && reader.ok; i++) {
+        std::string name = reader.ReadString(static_cast<int>(reader.Read(1)));
+        bool found = false;
+
+        for (int m = 0; m < NUM_MATERIALS; m++) {
+            if (CellStateToString(static_cast<CellState>(m)) == name) {
+                remap.push_back(static_cast<CellState>(m));
+                found = true;
+                break;
+            }
+        }
+
+        if (reader.ok && !found) {
+            error = "unknown material " + name;
+            return false;
+        }
+    }
+
+    //Older files carry the combo table the reactions used to be rolled into and the grid wide
+    //generator that rolled them, reactions are fixed now
+    if (version < 3) {
+        reader.ReadString(materialCount * materialCount);
+        reader.Read(8);
+        reader.Read(8);
+    }
+
+    int chunkCount = static_cast<int>(reader.Read(4));
+
+    if (reader.ok && chunkCount != Grid.ChunksX() * Grid.ChunksY()) {
+        error = "chunk count doesn't match the grid";
+        return false;
+    }
+
+    std::vector<Rng> chunkRngs(reader.ok ? chunkCount : 0);
+    std::vector<DirtyRect> chunkRects(chunkRngs.size());
+
+    for (int i = 0; i < static_cast<int>(chunkRngs.size()); i++) {
+        chunkRngs[i].state = reader.Read(8);
+        chunkRngs[i].increment = reader.Read(8);
+
+        if (version < 3) continue;
+
+        DirtyRect& rect = chunkRects[i];
+        rect.minX = static_cast<int32_t>(reader.Read(4));
+        rect.minY = static_cast<int32_t>(reader.Read(4));
+        rect.maxX = static_cast<int32_t>(reader.Read(4));
+        rect.maxY = static_cast<int32_t>(reader.Read(4));
+
+        //Pending updates stay inside their own chunk
+        int chunkMinX = (i % Grid.ChunksX()) * CHUNK_SIZE;
+        int chunkMinY = (i / Grid.ChunksX()) * CHUNK_SIZE;
+
+        if (reader.ok && !rect.Empty() && (rect.minX < chunkMinX || rect.minY < chunkMinY ||
+            rect.maxX >= chunkMinX + CHUNK_SIZE || rect.maxY >= chunkMinY + CHUNK_SIZE)) {
+            error = "bad chunk rect";
+            return false;
+        }
+    }
+
+    if (!reader.ok || !ReadRows(reader, Grid, version, remap.data(), materialCount, false)) {
+        error = "world file is truncated or corrupt";
+        return false;
+    }
+
+    //Everything checked out, replace the world. The pending updates go back as they were, older
+    //files don't have them and wake everything instead.
+    Grid.ClearWake();
+    ReadRows(reader, Grid, version, remap.data(), materialCount, true);
+
+    for (int i = 0; i < chunkCount; i++) {
+        Grid.GetChunk(i).rng = chunkRngs[i];
+        Grid.RestoreWake(i, chunkRects[i]);
+    }
+
+    if (version < 3) Grid.WakeAll();
+
+    return true;
+}
+
+#pragma endregion
@@ -0,0 +1,34 @@
+#pragma once
+// C++ Standard Libraries
+#include <string>
+#include <cstdint>
+
+#include "grid.h"
+
+//Binary world files: grid size, material names, every chunk's RNG state and the cells
+//themselves, each row run length encoded (long runs of EMPTY/BEDROCK make up most worlds).
+//Loading goes through a memory mapped file. A loaded world has the same cells, generator positions
+//and pending updates (chunk rects and worklists) as the saved one, so it carries on tick for tick.
+//
+//Layout (little endian):
+//  "SNDW", u32 version
+//  i32 length, i32 width
+//  u8 material count, per material: u8 name length, name
+//  u32 chunk count, per chunk: u64 rng state, u64 rng increment,
+//    i32 minX, minY, maxX, maxY of the cells to update next tick (max < min when asleep)
+//  per row: runs of (u16 count, u8 state, u8 wetness, u8 combo timer, u8 velocity) covering the row,
+//    the top bit of wetness is set when the cells are on their chunk's worklist
+//Version 1 and 2 files have a u8 combo table [material][material] and a grid wide generator
+//(u64 state, u64 increment) after the names, both skipped, and no pending updates: every cell is
+//woken instead. Version 1 files have no velocity byte, their particles load at rest.
+
+const uint32_t WORLD_FILE_VERSION = 3;
+
+bool SaveWorld(const std::string& path, const CellGrid& Grid, std::string& error);
+
+//Size of the world in a file, to build a grid to load it into
+bool ReadWorldSize(const std::string& path, int& length, int& width, std::string& error);
+
+//Load a world into a grid of the same size. Materials are matched by name, so files stay
+//readable when materials are added or reordered. The grid is left alone on failure.
+bool LoadWorld(const std::string& path, CellGrid& Grid, std::string& error);